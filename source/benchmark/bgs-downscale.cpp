@@ -0,0 +1,90 @@
+#include "opencv2/imgproc.hpp"
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../machine-learning/bgs-downscale.hpp"
+
+using namespace std;
+using namespace cv;
+
+struct Config
+{
+    string name;
+    int factor;
+    bool refine;
+    Ptr<ScaledBackgroundSubtractor> subtractor;
+    double seconds, iou;
+    Mat mask;
+};
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{width    |3840|frame width}"
+                             "{height   |2160|frame height}"
+                             "{frames   |150|number of frames}"
+                             "{warmup   |50|frames used to learn the background before scoring}"
+                             "{help    h|false|show help message}");
+    parser.about("Quality vs cost of MOG2 on downsampled frames with full resolution mask upsampling.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    Size size(parser.get<int>("width"), parser.get<int>("height"));
+    int frames = parser.get<int>("frames");
+    int warmup = parser.get<int>("warmup");
+
+    // the scene gives the ground truth foreground of every frame
+    SyntheticScene scene(SCENE_PEOPLE, size);
+
+    const int factors[] = {1, 2, 2, 4, 4};
+    const bool refines[] = {false, false, true, false, true};
+    vector<Config> configs;
+    for (int i = 0; i < 5; i++)
+    {
+        Config c;
+        c.factor = factors[i];
+        c.refine = refines[i];
+        c.name = format("%dx%s", c.factor, c.refine ? " + refine" : "");
+        ScaledBackgroundSubtractor::Params params;
+        params.factor = c.factor;
+        params.refine = c.refine;
+        Ptr<BackgroundSubtractorMOG2> mog2 = createBackgroundSubtractorMOG2();
+        mog2->setVarThreshold(10);
+        c.subtractor = makePtr<ScaledBackgroundSubtractor>(mog2, params);
+        c.seconds = 0;
+        c.iou = 0;
+        configs.push_back(c);
+    }
+
+    Mat frame, truth, fg;
+    for (int f = 0; f < warmup + frames; f++)
+    {
+        scene.render(f, frame, &truth);
+        for (size_t i = 0; i < configs.size(); i++)
+        {
+            Config& c = configs[i];
+            int64 t = getTickCount();
+            c.subtractor->apply(frame, c.mask);
+            if (f < warmup)
+                continue;
+            c.seconds += (getTickCount() - t) / getTickFrequency();
+
+            threshold(c.mask, fg, 200, 255, THRESH_BINARY);
+            double uni = countNonZero(fg | truth);
+            c.iou += uni > 0 ? countNonZero(fg & truth) / uni : 1.0;
+        }
+    }
+
+    cout << frames << " frames at " << size << endl;
+    cout << format("%-14s %12s %10s %8s", "config", "ms/frame", "speedup", "IoU") << endl;
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const Config& c = configs[i];
+        cout << format("%-14s %12.2f %9.1fx %8.3f", c.name.c_str(), c.seconds * 1000 / frames,
+                       configs[0].seconds / c.seconds, c.iou / frames) << endl;
+    }
+    return 0;
+}
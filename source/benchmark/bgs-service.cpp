@@ -0,0 +1,93 @@
+#include "opencv2/imgproc.hpp"
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../machine-learning/bgs-service.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{streams  |64|number of camera streams}"
+                             "{workers  |0|number of workers, 0 for one per hardware thread}"
+                             "{frames   |200|frames per stream}"
+                             "{warmup   |20|frames per stream before timing starts}"
+                             "{width    |1280|frame width}"
+                             "{height   |720|frame height}"
+                             "{fps      |25|camera frame rate used to report streams per core}"
+                             "{nopin    |false|do not pin workers to cores}"
+                             "{downscale|1|run the models on frames downsampled by this factor}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of multi-stream background subtraction, in streams per core.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    int streams = parser.get<int>("streams");
+    int frames = parser.get<int>("frames");
+    int warmup = parser.get<int>("warmup");
+    Size size(parser.get<int>("width"), parser.get<int>("height"));
+    double fps = parser.get<double>("fps");
+
+    // the workers provide the parallelism
+    setNumThreads(0);
+
+    BackgroundService::Params params;
+    params.workers = parser.get<int>("workers");
+    params.pinWorkers = !parser.get<bool>("nopin");
+    params.downscale = parser.get<int>("downscale");
+    atomic<int64_t> components(0);
+    BackgroundService service(streams, params, [&](const ForegroundResult& r) {
+        components += (int64_t)r.components.size();
+    });
+
+    // one synthetic camera per stream
+    vector<SyntheticScene> scenes;
+    for (int s = 0; s < streams; s++)
+        scenes.push_back(SyntheticScene(SCENE_PEOPLE, size, (uint64)s + 1));
+
+    Mat frame;
+    for (int f = 0; f < warmup; f++)
+        for (int s = 0; s < streams; s++)
+        {
+            scenes[s].render(f, frame);
+            service.submit(s, frame, f);
+        }
+    service.flush();
+    vector<double> busyStart = service.busyTime();
+
+    int64 t = getTickCount();
+    for (int f = warmup; f < warmup + frames; f++)
+        for (int s = 0; s < streams; s++)
+        {
+            scenes[s].render(f, frame);
+            service.submit(s, frame, f);
+        }
+    service.flush();
+    double wall = (getTickCount() - t) / getTickFrequency();
+
+    vector<double> busy = service.busyTime();
+    double busyTotal = 0;
+    for (size_t i = 0; i < busy.size(); i++)
+        busyTotal += busy[i] - busyStart[i];
+    double msPerFrame = busyTotal * 1000 / ((double)streams * frames);
+
+    cout << streams << " streams at " << size << ", " << service.workerCount() << " workers" << endl;
+    cout << "wall time:        " << wall << " s, " << streams * frames / wall << " frames/s" << endl;
+    cout << "per frame:        " << msPerFrame << " ms of worker time" << endl;
+    cout << "streams per core: " << 1000 / msPerFrame / fps << " at " << fps << " fps" << endl;
+    cout << "components:       " << components.load() << endl;
+    return 0;
+}
+
+/*
+Example usage:
+
+    ./build/bench-bgs-service --streams=64 --frames=300
+*/
@@ -0,0 +1,85 @@
+#include "opencv2/imgproc.hpp"
+#include <cfloat>
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../computer-vision/convex-hull-batch.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{points   |2000000|total points per run, split into sets of each size}"
+                             "{iters    |3|number of timed runs, the best one is reported}"
+                             "{help    h|false|show help message}");
+    parser.about("Batched radix sort + monotone chain hulls against per set cv::convexHull.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int total = parser.get<int>("points"), iters = max(1, parser.get<int>("iters"));
+    cout << getNumThreads() << " threads" << endl;
+
+    const int sizes[] = {8, 32, 128, 1000, 10000};
+    for (int size : sizes)
+    {
+        // sets of detections / contour points spread over a 4K frame
+        int sets = max(1, total / size);
+        RNG rng(42);
+        vector<Point> points(sets * size);
+        vector<int> offsets(sets + 1);
+        for (int s = 0; s < sets; s++)
+        {
+            offsets[s] = s * size;
+            Point center(rng.uniform(0, 3840), rng.uniform(0, 2160));
+            int radius = rng.uniform(4, 200);
+            for (int i = 0; i < size; i++)
+                points[s * size + i] = center + Point(rng.uniform(-radius, radius), rng.uniform(-radius, radius));
+        }
+        offsets[sets] = sets * size;
+
+        vector<vector<Point> > reference(sets);
+        double best = DBL_MAX;
+        for (int it = 0; it < iters; it++)
+        {
+            int64 t = getTickCount();
+            // a header on the points of each set, nothing is copied
+            for (int s = 0; s < sets; s++)
+                convexHull(Mat(offsets[s + 1] - offsets[s], 1, CV_32SC2, &points[offsets[s]]), reference[s]);
+            best = min(best, (getTickCount() - t) / getTickFrequency());
+        }
+        reportTiming(format("cv::convexHull n=%d", size), best, sets);
+
+        vector<Point> hullPoints;
+        vector<int> hullOffsets;
+        best = DBL_MAX;
+        for (int it = 0; it < iters; it++)
+        {
+            int64 t = getTickCount();
+            convexHullBatch(points, offsets, hullPoints, hullOffsets);
+            best = min(best, (getTickCount() - t) / getTickFrequency());
+        }
+        reportTiming(format("batched n=%d", size), best, sets);
+
+        // same vertices, possibly starting elsewhere: compare counts and areas
+        int mismatches = 0;
+        for (int s = 0; s < sets; s++)
+        {
+            vector<Point> hull(hullPoints.begin() + hullOffsets[s], hullPoints.begin() + hullOffsets[s + 1]);
+            if (hull.size() != reference[s].size() || contourArea(hull) != contourArea(reference[s]))
+                mismatches++;
+        }
+        printf("%-28s %10d sets, %d differ from cv::convexHull\n", "", sets, mismatches);
+    }
+    return 0;
+}
+
+/*
+Example usage (the ms/frame and fps columns are per point set):
+
+    ./build/bench-convex-hull-batch --points=10000000
+*/
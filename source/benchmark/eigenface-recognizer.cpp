@@ -0,0 +1,86 @@
+#include "opencv2/features2d.hpp"
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../computer-vision/eigenface-recognizer.hpp"
+#include "../computer-vision/randomized-pca.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{dim      |10304|image dimension, 10304 is a 92x112 att_faces image}"
+                             "{train    |1000|images used to compute the basis}"
+                             "{components|100|dimensions of the eigenspace}"
+                             "{gallery  |100000|gallery size}"
+                             "{queries  |1000|query images}"
+                             "{k        |5|matches per query}"
+                             "{help    h|false|show help message}");
+    parser.about("Throughput of batched eigenface projection and top-k matching against BFMatcher.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int dim = parser.get<int>("dim"), components = parser.get<int>("components");
+    int gallerySize = parser.get<int>("gallery"), queries = parser.get<int>("queries");
+    int k = parser.get<int>("k");
+    cout << getNumThreads() << " threads" << endl;
+
+    RandomizedPCAParams params;
+    params.components = components;
+    PCA pca = randomizedPCA(lowRankData(parser.get<int>("train"), dim, 200), params);
+
+    // gallery coefficients drawn with the variance of each component, a
+    // gallery of images this size would not fit in memory
+    Mat coeffs(gallerySize, pca.eigenvectors.rows, CV_32F);
+    RNG rng(7);
+    rng.fill(coeffs, RNG::NORMAL, 0, 1);
+    for (int j = 0; j < coeffs.cols; j++)
+    {
+        Mat col_j = coeffs.col(j);
+        col_j *= sqrt(max(pca.eigenvalues.at<float>(j), 0.f));
+    }
+    vector<int> labels(gallerySize);
+    for (int i = 0; i < gallerySize; i++)
+        labels[i] = i;
+
+    EigenfaceRecognizer l2(pca, EigenfaceRecognizer::L2), cosine(pca, EigenfaceRecognizer::COSINE);
+    l2.addProjected(coeffs, labels);
+    cosine.addProjected(coeffs, labels);
+
+    Mat images = lowRankData(queries, dim, 200, 1, 11), projected;
+    int64 t = getTickCount();
+    l2.project(images, projected);
+    reportTiming("project (one GEMM)", (getTickCount() - t) / getTickFrequency(), queries);
+
+    vector<vector<FaceMatch> > l2Matches, cosineMatches;
+    t = getTickCount();
+    l2.matchProjected(projected, k, l2Matches);
+    reportTiming(format("top-%d L2", k), (getTickCount() - t) / getTickFrequency(), queries);
+    t = getTickCount();
+    cosine.matchProjected(projected, k, cosineMatches);
+    reportTiming(format("top-%d cosine", k), (getTickCount() - t) / getTickFrequency(), queries);
+
+    // reference, and check of the top-1 against it
+    vector<vector<DMatch> > reference;
+    BFMatcher matcher(NORM_L2);
+    t = getTickCount();
+    matcher.knnMatch(projected, coeffs, reference, k);
+    reportTiming(format("BFMatcher knn k=%d", k), (getTickCount() - t) / getTickFrequency(), queries);
+
+    int agree = 0;
+    for (int q = 0; q < queries; q++)
+        agree += !reference[q].empty() && !l2Matches[q].empty() && reference[q][0].trainIdx == l2Matches[q][0].index;
+    cout << "top-1 agreement with BFMatcher: " << agree << " / " << queries << endl;
+    return 0;
+}
+
+/*
+Example usage:
+
+    ./build/bench-eigenface-recognizer --gallery=1000000 --components=64
+*/
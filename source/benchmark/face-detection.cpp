@@ -0,0 +1,61 @@
+#include "opencv2/objdetect.hpp"
+#include "opencv2/imgproc.hpp"
+#include <iostream>
+
+#include "fixtures.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{cascade  |haarcascades/haarcascade_frontalface_alt.xml|primary trained classifier}"
+                             "{scale    |1.3|image scale, as in the face-detection demo}"
+                             "{width    |1280|frame width}"
+                             "{height   |720|frame height}"
+                             "{frames   |200|number of frames}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of the cascade face detection pipeline on synthetic faces.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    CascadeClassifier cascade;
+    if (!cascade.load(samples::findFileOrKeep(parser.get<string>("cascade"))))
+    {
+        cerr << "ERROR: Could not load classifier cascade" << endl;
+        return 1;
+    }
+    double scale = max(1.0, parser.get<double>("scale"));
+    int frames = parser.get<int>("frames");
+    SyntheticScene scene(SCENE_FACES, Size(parser.get<int>("width"), parser.get<int>("height")));
+
+    FrameSource source(scene.reader(frames), 4, FrameSource::Block);
+    FrameSource::Frame frame;
+    Mat gray, smallImg;
+    vector<Rect> faces;
+    double seconds = 0;
+    size_t found = 0;
+    int64 start = getTickCount();
+    while (source.read(frame))
+    {
+        // same preprocessing and parameters as detectAndDraw
+        int64 t = getTickCount();
+        cvtColor(frame.image, gray, COLOR_BGR2GRAY);
+        resize(gray, smallImg, Size(), 1 / scale, 1 / scale, INTER_LINEAR_EXACT);
+        equalizeHist(smallImg, smallImg);
+        cascade.detectMultiScale(smallImg, faces, 1.1, 2,
+                                 CASCADE_FIND_BIGGEST_OBJECT | CASCADE_DO_ROUGH_SEARCH | CASCADE_SCALE_IMAGE,
+                                 Size(30, 30));
+        seconds += (getTickCount() - t) / getTickFrequency();
+        found += faces.size();
+    }
+
+    reportTiming("face detection", seconds, frames);
+    reportTiming("face detection (wall)", (getTickCount() - start) / getTickFrequency(), frames);
+    cout << "faces: " << found << endl;
+    return 0;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../machine-learning/frame-source.hpp"
+
+// Deterministic synthetic scenes used by the benchmarks instead of camera or
+// dataset files. The same kind, size and seed always give the same frames.
+enum SceneKind
+{
+    SCENE_SHAPES,   // moving circles, rectangles and triangles
+    SCENE_FACES,    // face-like patterns: skin ellipse, eyes, brows and mouth
+    SCENE_PEOPLE,   // upright people-sized silhouettes walking across
+    SCENE_LINES     // line-rich facades and edges, slow pan
+};
+
+class SyntheticScene
+{
+public:
+    SyntheticScene(SceneKind kind_, cv::Size size_, uint64 seed_ = 42)
+        : kind(kind_), size(size_), seed(seed_)
+    {
+        cv::RNG rng(seed);
+        background.create(size, CV_8UC3);
+        rng.fill(background, cv::RNG::UNIFORM, 60, 200);
+        cv::GaussianBlur(background, background, cv::Size(0, 0), 6);
+
+        if (kind == SCENE_LINES)
+            drawFacades(rng);
+
+        int count = kind == SCENE_SHAPES ? 12 : kind == SCENE_FACES ? 6 : kind == SCENE_PEOPLE ? 8 : 0;
+        int scale = std::min(size.width, size.height);
+        for (int i = 0; i < count; i++)
+        {
+            Object o;
+            o.shape = rng.uniform(0, 3);
+            o.h = kind == SCENE_PEOPLE ? rng.uniform(scale / 5, scale / 3) : rng.uniform(scale / 12, scale / 5);
+            o.w = kind == SCENE_PEOPLE ? o.h * 2 / 5 : kind == SCENE_FACES ? o.h * 3 / 4 : rng.uniform(scale / 12, scale / 5);
+            o.pos = cv::Point2f(rng.uniform(0.f, (float)size.width), rng.uniform(0.f, (float)(size.height - o.h)));
+            o.vel = cv::Point2f(rng.uniform(-4.f, 4.f), kind == SCENE_PEOPLE ? 0.f : rng.uniform(-2.f, 2.f));
+            o.color = cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+            objects.push_back(o);
+        }
+    }
+
+    // Render frame `index` into dst, and its foreground mask if requested.
+    void render(int index, cv::Mat& dst, cv::Mat* mask = NULL) const
+    {
+        if (kind == SCENE_LINES)
+        {
+            // slow horizontal pan over the static facades
+            int shift = index % size.width;
+            dst.create(size, CV_8UC3);
+            background.colRange(shift, size.width).copyTo(dst.colRange(0, size.width - shift));
+            if (shift > 0)
+                background.colRange(0, shift).copyTo(dst.colRange(size.width - shift, size.width));
+        }
+        else
+            background.copyTo(dst);
+        if (mask)
+        {
+            mask->create(size, CV_8UC1);
+            mask->setTo(cv::Scalar::all(0));
+        }
+
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            const Object& o = objects[i];
+            // wrap around the frame, with a margin so objects fully leave it
+            float wrapW = (float)(size.width + 2 * o.w), wrapH = (float)(size.height + 2 * o.h);
+            float x = o.pos.x + o.vel.x * index + o.w, y = o.pos.y + o.vel.y * index + o.h;
+            x = x - wrapW * std::floor(x / wrapW) - o.w;
+            y = y - wrapH * std::floor(y / wrapH) - o.h;
+            cv::Rect box(cvRound(x), cvRound(y), o.w, o.h);
+            drawObject(dst, o, box, false);
+            if (mask)
+                drawObject(*mask, o, box, true);
+        }
+
+        // per frame sensor noise, the buffer is reused by the frames rendered
+        // on the same thread
+        static thread_local cv::Mat noise;
+        noise.create(size, CV_16SC3);
+        cv::RNG(seed + index + 1).fill(noise, cv::RNG::NORMAL, 0, 3);
+        cv::add(dst, noise, dst, cv::noArray(), CV_8U);
+    }
+
+    // Reader producing `frames` frames, to feed a FrameSource like a camera.
+    FrameSource::Reader reader(int frames) const
+    {
+        int index = 0;
+        return [this, frames, index](cv::Mat& dst) mutable {
+            if (index >= frames)
+                return false;
+            render(index++, dst);
+            return true;
+        };
+    }
+
+    // Write the frames to a local video file so the demos can run on them.
+    bool writeVideo(const std::string& path, int frames, double fps = 25) const
+    {
+        cv::VideoWriter writer(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, size);
+        if (!writer.isOpened())
+            return false;
+        cv::Mat frame;
+        for (int i = 0; i < frames; i++)
+        {
+            render(i, frame);
+            writer << frame;
+        }
+        return true;
+    }
+
+private:
+    struct Object
+    {
+        int shape, w, h;
+        cv::Point2f pos, vel;
+        cv::Scalar color;
+    };
+
+    void drawFacades(cv::RNG& rng)
+    {
+        for (int b = 0; b < 12; b++)
+        {
+            cv::Rect facade(rng.uniform(0, size.width), rng.uniform(0, size.height / 2),
+                            rng.uniform(size.width / 10, size.width / 4), size.height);
+            cv::Scalar wall(rng.uniform(40, 220), rng.uniform(40, 220), rng.uniform(40, 220));
+            cv::rectangle(background, facade, wall, cv::FILLED);
+            int step = rng.uniform(12, 40);
+            for (int y = facade.y + step / 2; y < size.height - step; y += step)
+                for (int x = facade.x + step / 2; x < facade.br().x - step; x += step)
+                    cv::rectangle(background, cv::Rect(x, y, step / 2, step * 2 / 3), wall * 0.5, cv::FILLED);
+        }
+        for (int i = 0; i < 200; i++)
+        {
+            cv::Point a(rng.uniform(0, size.width), rng.uniform(0, size.height));
+            double angle = rng.uniform(0., CV_PI);
+            double len = rng.uniform(20., size.width / 4.);
+            cv::Point b(cvRound(a.x + len * std::cos(angle)), cvRound(a.y + len * std::sin(angle)));
+            cv::line(background, a, b, cv::Scalar::all(rng.uniform(0, 256)), rng.uniform(1, 3), cv::LINE_AA);
+        }
+    }
+
+    void drawObject(cv::Mat& img, const Object& o, const cv::Rect& box, bool mask) const
+    {
+        cv::Scalar c = mask ? cv::Scalar(255) : o.color;
+        cv::Point center(box.x + box.width / 2, box.y + box.height / 2);
+        switch (kind)
+        {
+        case SCENE_FACES:
+        {
+            cv::Scalar skin = mask ? c : cv::Scalar(140, 170, 220);
+            cv::ellipse(img, center, cv::Size(box.width / 2, box.height / 2), 0, 0, 360, skin, cv::FILLED);
+            if (mask)
+                break;
+            cv::Scalar dark(40, 40, 60);
+            int ex = box.width / 5, ey = box.height / 8, er = std::max(2, box.width / 12);
+            cv::ellipse(img, center + cv::Point(-ex, -ey), cv::Size(er * 3 / 2, er), 0, 0, 360, dark, cv::FILLED);
+            cv::ellipse(img, center + cv::Point(ex, -ey), cv::Size(er * 3 / 2, er), 0, 0, 360, dark, cv::FILLED);
+            cv::line(img, center + cv::Point(-ex - er, -ey - 2 * er), center + cv::Point(-ex + er, -ey - 2 * er), dark, 2);
+            cv::line(img, center + cv::Point(ex - er, -ey - 2 * er), center + cv::Point(ex + er, -ey - 2 * er), dark, 2);
+            cv::ellipse(img, center + cv::Point(0, box.height / 5), cv::Size(box.width / 6, box.height / 14),
+                        0, 0, 180, dark, 2);
+            break;
+        }
+        case SCENE_PEOPLE:
+        {
+            int head = box.width / 2;
+            cv::circle(img, cv::Point(center.x, box.y + head / 2), head / 2, c, cv::FILLED);
+            cv::rectangle(img, cv::Rect(box.x, box.y + head, box.width, box.height * 2 / 5), c, cv::FILLED);
+            int legTop = box.y + head + box.height * 2 / 5;
+            cv::rectangle(img, cv::Rect(box.x + box.width / 8, legTop, box.width / 3, box.br().y - legTop), c, cv::FILLED);
+            cv::rectangle(img, cv::Rect(center.x + box.width / 24, legTop, box.width / 3, box.br().y - legTop), c, cv::FILLED);
+            break;
+        }
+        default:
+            if (o.shape == 0)
+                cv::ellipse(img, center, cv::Size(box.width / 2, box.height / 2), 0, 0, 360, c, cv::FILLED);
+            else if (o.shape == 1)
+                cv::rectangle(img, box, c, cv::FILLED);
+            else
+            {
+                std::vector<cv::Point> tri(3);
+                tri[0] = cv::Point(center.x, box.y);
+                tri[1] = cv::Point(box.x, box.br().y);
+                tri[2] = box.br();
+                cv::fillConvexPoly(img, tri, c);
+            }
+        }
+    }
+
+    SceneKind kind;
+    cv::Size size;
+    uint64 seed;
+    cv::Mat background;
+    std::vector<Object> objects;
+};
+
+// Rows of dimension cols spread around a rank-dimensional subspace with a
+// decaying spectrum plus isotropic noise, like vectorized face images.
+inline cv::Mat lowRankData(int rows, int cols, int rank, double noise = 1, uint64 seed = 42)
+{
+    cv::RNG rng(seed);
+    cv::Mat coeffs(rows, rank, CV_32F), basis(rank, cols, CV_32F);
+    rng.fill(coeffs, cv::RNG::NORMAL, 0, 1);
+    rng.fill(basis, cv::RNG::NORMAL, 0, 1.0 / std::sqrt((double)cols));
+    for (int j = 0; j < rank; j++)
+    {
+        cv::Mat col_j = coeffs.col(j);
+        col_j *= 2000.0 / (j + 1);
+    }
+
+    cv::Mat data = coeffs * basis, offsets(rows, cols, CV_32F);
+    rng.fill(offsets, cv::RNG::NORMAL, 128, noise);
+    data += offsets;
+    return data;
+}
+
+// One line per measurement, in the same format for every benchmark so that
+// runs can be compared side by side.
+inline void reportTiming(const std::string& name, double seconds, int frames)
+{
+    double ms = seconds * 1000 / std::max(1, frames);
+    printf("%-28s %10.3f ms/frame %10.1f fps\n", name.c_str(), ms, ms > 0 ? 1000 / ms : 0.0);
+}
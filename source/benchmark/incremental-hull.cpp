@@ -0,0 +1,63 @@
+#include "opencv2/imgproc.hpp"
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../computer-vision/incremental-hull.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{points   |20000|points inserted one at a time}"
+                             "{queries  |4|contains() queries after each insertion}"
+                             "{help    h|false|show help message}");
+    parser.about("Incremental hull insertion against cv::convexHull recomputed after each new point.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int count = parser.get<int>("points"), queries = parser.get<int>("queries");
+
+    // trajectory: a random walk, like a tracked object
+    RNG rng(42);
+    vector<Point> points(count);
+    Point2f pos(0, 0), vel(0, 0);
+    for (int i = 0; i < count; i++)
+    {
+        vel = vel * 0.95f + Point2f((float)rng.gaussian(1), (float)rng.gaussian(1));
+        pos += vel;
+        points[i] = Point(cvRound(pos.x * 10), cvRound(pos.y * 10));
+    }
+
+    vector<Point> hull;
+    int64 t = getTickCount();
+    for (int i = 0; i < count; i++)
+        convexHull(vector<Point>(points.begin(), points.begin() + i + 1), hull);
+    reportTiming("cv::convexHull recomputed", (getTickCount() - t) / getTickFrequency(), count);
+    double referenceArea = contourArea(hull);
+
+    IncrementalHull incremental;
+    int inside = 0;
+    t = getTickCount();
+    for (int i = 0; i < count; i++)
+    {
+        incremental.insert(points[i]);
+        for (int q = 0; q < queries; q++)
+            inside += incremental.contains(points[(i * 7 + q * 13) % count]);
+    }
+    reportTiming("incremental insert + queries", (getTickCount() - t) / getTickFrequency(), count);
+
+    cout << "hull: " << incremental.size() << " vertices (cv::convexHull " << hull.size() << "), area "
+         << incremental.area() << " (cv::convexHull " << referenceArea << "), " << inside << " queries inside" << endl;
+    return 0;
+}
+
+/*
+Example usage (ms/frame and fps are per inserted point):
+
+    ./build/bench-incremental-hull --points=50000
+*/
@@ -0,0 +1,97 @@
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include <cfloat>
+#include <iostream>
+
+#include "fixtures.hpp"
+#include "../machine-learning/tiled-lsd.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Fraction of the pixels covered by segments `a` that are within `tol`
+// pixels of a segment of `b`.
+static double coverage(const vector<Vec4f>& a, const vector<Vec4f>& b, Size size, int tol)
+{
+    Mat ma = Mat::zeros(size, CV_8UC1), mb = Mat::zeros(size, CV_8UC1);
+    for (size_t i = 0; i < a.size(); i++)
+        line(ma, Point2f(a[i][0], a[i][1]), Point2f(a[i][2], a[i][3]), Scalar(255));
+    for (size_t i = 0; i < b.size(); i++)
+        line(mb, Point2f(b[i][0], b[i][1]), Point2f(b[i][2], b[i][3]), Scalar(255));
+    dilate(mb, mb, getStructuringElement(MORPH_RECT, Size(2 * tol + 1, 2 * tol + 1)));
+    double total = countNonZero(ma);
+    return total > 0 ? countNonZero(ma & mb) / total : 1.0;
+}
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{input   i||optional input image, a synthetic scene is generated otherwise}"
+                             "{width    |6000|synthetic scene width}"
+                             "{height   |4000|synthetic scene height}"
+                             "{seed     |42|seed of the synthetic scene}"
+                             "{tile     |1024|tile size in pixels}"
+                             "{overlap  |32|overlap between tiles in pixels}"
+                             "{iters    |3|number of timed runs, the best one is reported}"
+                             "{tol      |2|tolerance in pixels of the coverage comparison}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of tiled parallel LSD against the single pass detector.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    Mat image;
+    if (parser.has("input"))
+        image = imread(parser.get<String>("input"), IMREAD_GRAYSCALE);
+    else
+    {
+        SyntheticScene scene(SCENE_LINES, Size(parser.get<int>("width"), parser.get<int>("height")),
+                             (uint64)parser.get<int>("seed"));
+        Mat frame;
+        scene.render(0, frame);
+        cvtColor(frame, image, COLOR_BGR2GRAY);
+    }
+    if (image.empty())
+    {
+        cout << "Unable to load " << parser.get<String>("input") << endl;
+        return 1;
+    }
+
+    TiledLsdParams params;
+    params.tileSize = parser.get<int>("tile");
+    params.overlap = parser.get<int>("overlap");
+    int iters = max(1, parser.get<int>("iters"));
+
+    cout << "Image: " << image.size() << " (" << image.total() / 1e6 << " MP), "
+         << getNumThreads() << " threads" << endl;
+
+    vector<Vec4f> single, tiled;
+    double bestSingle = DBL_MAX, bestTiled = DBL_MAX;
+    for (int it = 0; it < iters; it++)
+    {
+        Ptr<LineSegmentDetector> ls = createLineSegmentDetector(LSD_REFINE_NONE);
+        int64 t = getTickCount();
+        ls->detect(image, single);
+        bestSingle = min(bestSingle, (getTickCount() - t) * 1000. / getTickFrequency());
+
+        t = getTickCount();
+        detectLinesTiled(image, tiled, params);
+        bestTiled = min(bestTiled, (getTickCount() - t) * 1000. / getTickFrequency());
+    }
+
+    int tol = parser.get<int>("tol");
+    cout << "single pass: " << bestSingle << " ms, " << single.size() << " segments" << endl;
+    cout << "tiled:       " << bestTiled << " ms, " << tiled.size() << " segments" << endl;
+    cout << "speedup:     " << bestSingle / bestTiled << "x" << endl;
+    cout << "recall (single covered by tiled):    " << coverage(single, tiled, image.size(), tol) << endl;
+    cout << "precision (tiled covered by single): " << coverage(tiled, single, image.size(), tol) << endl;
+    return 0;
+}
+
+/*
+Example usage:
+
+    ./build/bench-line-segment-tiled --width=10000 --height=8000 --tile=2048
+*/
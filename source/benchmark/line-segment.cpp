@@ -0,0 +1,47 @@
+#include "opencv2/imgproc.hpp"
+#include <iostream>
+
+#include "fixtures.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{refine  r|false|use LSD_REFINE_STD instead of LSD_REFINE_NONE}"
+                             "{width    |1920|frame width}"
+                             "{height   |1080|frame height}"
+                             "{frames   |30|number of frames}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of the line segment detector on synthetic line-rich scenes.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    bool useRefine = parser.get<bool>("refine");
+    int frames = parser.get<int>("frames");
+    SyntheticScene scene(SCENE_LINES, Size(parser.get<int>("width"), parser.get<int>("height")));
+    Ptr<LineSegmentDetector> ls = createLineSegmentDetector(useRefine ? LSD_REFINE_STD : LSD_REFINE_NONE);
+
+    FrameSource source(scene.reader(frames), 4, FrameSource::Block);
+    FrameSource::Frame frame;
+    Mat gray;
+    vector<Vec4f> lines;
+    double seconds = 0;
+    size_t segments = 0;
+    while (source.read(frame))
+    {
+        cvtColor(frame.image, gray, COLOR_BGR2GRAY);
+        int64 t = getTickCount();
+        ls->detect(gray, lines);
+        seconds += (getTickCount() - t) / getTickFrequency();
+        segments += lines.size();
+    }
+
+    reportTiming(useRefine ? "lsd refine std" : "lsd refine none", seconds, frames);
+    cout << "segments: " << segments << endl;
+    return 0;
+}
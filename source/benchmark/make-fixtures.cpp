@@ -0,0 +1,43 @@
+#include <iostream>
+
+#include "fixtures.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Writes the synthetic scenes as local video files, so the interactive demos
+// can be run without a camera or downloaded datasets.
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{@dir     |.|output directory}"
+                             "{width    |1280|frame width}"
+                             "{height   |720|frame height}"
+                             "{frames   |250|frames per video}"
+                             "{seed     |42|scene seed}"
+                             "{help    h|false|show help message}");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    String dir = parser.get<String>("@dir");
+    Size size(parser.get<int>("width"), parser.get<int>("height"));
+    int frames = parser.get<int>("frames");
+    uint64 seed = (uint64)parser.get<int>("seed");
+
+    const SceneKind kinds[] = {SCENE_SHAPES, SCENE_FACES, SCENE_PEOPLE, SCENE_LINES};
+    const char* names[] = {"shapes", "faces", "people", "lines"};
+    for (int i = 0; i < 4; i++)
+    {
+        String path = dir + "/" + names[i] + ".avi";
+        if (!SyntheticScene(kinds[i], size, seed).writeVideo(path, frames))
+        {
+            cerr << "Can not write " << path << endl;
+            return 1;
+        }
+        cout << "Wrote " << path << endl;
+    }
+    return 0;
+}
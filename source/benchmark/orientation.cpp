@@ -0,0 +1,92 @@
+#include "opencv2/imgproc.hpp"
+#include <cfloat>
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../computer-vision/orientation.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Reference: one cv::PCA per contour, as getOrientation did.
+static double pcaAngle(const vector<Point>& pts)
+{
+    Mat data((int)pts.size(), 2, CV_64F);
+    for (int i = 0; i < data.rows; i++)
+    {
+        data.at<double>(i, 0) = pts[i].x;
+        data.at<double>(i, 1) = pts[i].y;
+    }
+    PCA pca(data, Mat(), PCA::DATA_AS_ROW);
+    return atan2(pca.eigenvectors.at<double>(0, 1), pca.eigenvectors.at<double>(0, 0));
+}
+
+// Difference of two axis angles, modulo pi.
+static double axisError(double a, double b)
+{
+    double d = fmod(fabs(a - b), CV_PI);
+    return min(d, CV_PI - d);
+}
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{blobs    |5000|number of contours}"
+                             "{iters    |5|number of timed runs, the best one is reported}"
+                             "{help    h|false|show help message}");
+    parser.about("Per contour cv::PCA against the batched closed form orientation.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int blobs = parser.get<int>("blobs"), iters = max(1, parser.get<int>("iters"));
+
+    // rotated elliptic blobs of random sizes, as findContours would return them
+    RNG rng(42);
+    vector<vector<Point> > contours(blobs);
+    for (int i = 0; i < blobs; i++)
+    {
+        Point center(rng.uniform(0, 4000), rng.uniform(0, 4000));
+        Size axes(rng.uniform(10, 60), rng.uniform(3, 10));
+        ellipse2Poly(center, axes, rng.uniform(0, 180), 0, 360, 2, contours[i]);
+    }
+
+    vector<double> reference(blobs);
+    double best = DBL_MAX;
+    for (int it = 0; it < iters; it++)
+    {
+        int64 t = getTickCount();
+        for (int i = 0; i < blobs; i++)
+            reference[i] = pcaAngle(contours[i]);
+        best = min(best, (getTickCount() - t) / getTickFrequency());
+    }
+    reportTiming("cv::PCA per contour", best, 1);
+
+    const OrientationMode modes[] = {ORIENTATION_POINTS, ORIENTATION_MOMENTS};
+    const char* names[] = {"batched points", "batched moments"};
+    for (int m = 0; m < 2; m++)
+    {
+        ContourOrientations out;
+        best = DBL_MAX;
+        for (int it = 0; it < iters; it++)
+        {
+            int64 t = getTickCount();
+            estimateOrientations(contours, out, modes[m]);
+            best = min(best, (getTickCount() - t) / getTickFrequency());
+        }
+        double worst = 0;
+        for (int i = 0; i < blobs; i++)
+            worst = max(worst, axisError(out.angle[i], reference[i]));
+        reportTiming(names[m], best, 1);
+        printf("%-28s %10.4f rad max angle difference to cv::PCA\n", "", worst);
+    }
+    return 0;
+}
+
+/*
+Example usage:
+
+    ./build/bench-orientation --blobs=20000
+*/
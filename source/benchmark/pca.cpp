@@ -0,0 +1,105 @@
+#include <cfloat>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../computer-vision/incremental-pca.hpp"
+#include "../computer-vision/pca-model.hpp"
+#include "../computer-vision/randomized-pca.hpp"
+
+using namespace std;
+using namespace cv;
+
+// ||X - backProject(project(X))|| / ||X - mean||, over all the rows.
+static double reconstructionError(const PCA& pca, const Mat& data)
+{
+    Mat rebuilt = pca.backProject(pca.project(data));
+    double centered = norm(data, NORM_L2SQR) - data.rows * norm(pca.mean, NORM_L2SQR);
+    return sqrt(norm(data, rebuilt, NORM_L2SQR) / centered);
+}
+
+static void run(const string& name, const Mat& data, int components, int iters)
+{
+    cout << name << ": " << data.rows << " x " << data.cols << ", " << components << " components" << endl;
+
+    // best of iters runs, the error of the last one
+    struct Backend
+    {
+        string name;
+        function<PCA()> fit;
+    };
+    vector<Backend> backends;
+    backends.push_back({"cv::PCA", [&] { return PCA(data, Mat(), PCA::DATA_AS_ROW, components); }});
+    for (int q = 0; q <= 2; q++)
+        backends.push_back({format("randomized q=%d", q), [&, q] {
+            RandomizedPCAParams params;
+            params.components = components;
+            params.powerIterations = q;
+            return randomizedPCA(data, params);
+        }});
+    backends.push_back({"incremental b=256", [&] {
+        IncrementalPCA ipca(components);
+        for (int r = 0; r < data.rows; r += 256)
+            ipca.partialFit(data.rowRange(r, min(data.rows, r + 256)));
+        return ipca.toPCA();
+    }});
+
+    for (size_t i = 0; i < backends.size(); i++)
+    {
+        double best = DBL_MAX;
+        PCA pca;
+        for (int it = 0; it < iters; it++)
+        {
+            int64 t = getTickCount();
+            pca = backends[i].fit();
+            best = min(best, (getTickCount() - t) / getTickFrequency());
+        }
+        reportTiming(backends[i].name, best, 1);
+        printf("%-28s %10.5f relative reconstruction error\n", "", reconstructionError(pca, data));
+    }
+
+    // answering a retained variance query: decomposition per query against
+    // a slice of the cached model, both followed by the projection of the data
+    PCAModel model = PCAModel::fit(data);
+    Mat points;
+    int64 t = getTickCount();
+    PCA recomputed(data, Mat(), PCA::DATA_AS_ROW, 0.95);
+    recomputed.project(data, points);
+    reportTiming("95% query, recomputed", (getTickCount() - t) / getTickFrequency(), 1);
+    t = getTickCount();
+    PCA sliced = model.sliceVariance(0.95);
+    sliced.project(data, points);
+    reportTiming(format("95%% query, sliced (k=%d)", sliced.eigenvectors.rows), (getTickCount() - t) / getTickFrequency(), 1);
+}
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{dim      |10304|row dimension, 10304 is a 92x112 att_faces image}"
+                             "{small    |400|rows of the att_faces sized dataset}"
+                             "{large    |2000|rows of the larger dataset}"
+                             "{rank     |200|rank of the synthetic data before noise}"
+                             "{components|100|components computed by every backend}"
+                             "{iters    |3|number of timed runs, the best one is reported}"
+                             "{help    h|false|show help message}");
+    parser.about("Time and reconstruction error of cv::PCA against the randomized and incremental backends.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int dim = parser.get<int>("dim"), rank = parser.get<int>("rank");
+    int components = parser.get<int>("components"), iters = max(1, parser.get<int>("iters"));
+    cout << getNumThreads() << " threads" << endl;
+
+    run("att_faces sized", lowRankData(parser.get<int>("small"), dim, rank), components, iters);
+    run("large", lowRankData(parser.get<int>("large"), dim, rank), components, iters);
+    return 0;
+}
+
+/*
+Example usage:
+
+    ./build/bench-pca --large=5000 --components=150 --iters=1
+*/
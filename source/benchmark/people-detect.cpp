@@ -0,0 +1,54 @@
+#include "opencv2/objdetect.hpp"
+#include <iostream>
+
+#include "fixtures.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{daimler  |false|use the Daimler detector instead of the default one}"
+                             "{width    |640|frame width}"
+                             "{height   |480|frame height}"
+                             "{frames   |50|number of frames}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of the HOG people detector on synthetic silhouettes.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    bool daimler = parser.get<bool>("daimler");
+    int frames = parser.get<int>("frames");
+    SyntheticScene scene(SCENE_PEOPLE, Size(parser.get<int>("width"), parser.get<int>("height")));
+
+    // same detectors and parameters as the people-detect demo
+    HOGDescriptor hog;
+    if (daimler)
+    {
+        hog = HOGDescriptor(Size(48, 96), Size(16, 16), Size(8, 8), Size(8, 8), 9);
+        hog.setSVMDetector(HOGDescriptor::getDaimlerPeopleDetector());
+    }
+    else
+        hog.setSVMDetector(HOGDescriptor::getDefaultPeopleDetector());
+
+    FrameSource source(scene.reader(frames), 4, FrameSource::Block);
+    FrameSource::Frame frame;
+    vector<Rect> found;
+    double seconds = 0;
+    size_t people = 0;
+    while (source.read(frame))
+    {
+        int64 t = getTickCount();
+        hog.detectMultiScale(frame.image, found, 0, Size(8,8), Size(), 1.05, 2, daimler);
+        seconds += (getTickCount() - t) / getTickFrequency();
+        people += found.size();
+    }
+
+    reportTiming(daimler ? "hog daimler" : "hog default", seconds, frames);
+    cout << "detections: " << people << endl;
+    return 0;
+}
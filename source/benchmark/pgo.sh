@@ -0,0 +1,139 @@
+#!/usr/bin/env bash
+#
+# Profile guided optimisation of the programs, and a report of its gain.
+#
+#   1. <out>/base: regular build, the reference.
+#   2. <out>/pgo:  instrumented build (VISION_PGO=GENERATE), trained on the
+#      workloads below, then rebuilt in place with VISION_PGO=USE. The same
+#      build directory is reused so the profiles match the object files.
+#   3. Both builds run the workloads, the best of REPEAT runs of every
+#      measurement goes to <out>/pgo-report.md.
+#
+# The workloads are the benchmarks on their deterministic synthetic scenes:
+# the face cascade, HOG, MOG2 with the segment refinement, LSD (single pass
+# and tiled), the fused preprocessing and the segmentation post-processing.
+# Only the code of this repository is optimised, time spent inside OpenCV
+# itself does not change.
+#
+# Usage: source/benchmark/pgo.sh [out-dir] [extra cmake arguments...]
+#   e.g. source/benchmark/pgo.sh build-pgo -DOpenCV_DIR=/path/to/opencv/build -DVISION_ARCH=native
+#
+# Environment: REPEAT (default 3), JOBS (default nproc), FACE_CASCADE
+# (haarcascade_frontalface_alt.xml, the face workload is skipped if missing).
+
+set -euo pipefail
+export LC_ALL=C
+
+root=$(cd "$(dirname "$0")/../.." && pwd)
+out=$(mkdir -p "${1:-build-pgo}" && cd "${1:-build-pgo}" && pwd)
+shift || true
+repeat=${REPEAT:-3}
+jobs=${JOBS:-$(nproc)}
+cascade=${FACE_CASCADE:-haarcascades/haarcascade_frontalface_alt.xml}
+
+workloads=(
+    "bench-face-detection --frames=100 --cascade=$cascade"
+    "bench-people-detect --frames=30"
+    "bench-segment-objects --frames=200"
+    "bench-refine-segments --frames=200"
+    "bench-line-segment --frames=20"
+    "bench-line-segment-tiled --iters=3"
+    "bench-preprocess --iters=20"
+    "bench-segmentation --frames=50"
+)
+targets=$(for w in "${workloads[@]}"; do echo "${w%% *}"; done)
+
+build()
+{
+    local dir=$1; shift
+    cmake -S "$root" -B "$dir" -DCMAKE_BUILD_TYPE=Release "$@" > /dev/null
+    cmake --build "$dir" --parallel "$jobs" --target $targets > /dev/null
+}
+
+# Run every workload once, a failing one is reported and skipped.
+run()
+{
+    local dir=$1 w
+    for w in "${workloads[@]}"; do
+        echo "## ${w%% *}"
+        "$dir"/$w || echo "FAILED: $w" >&2
+    done
+}
+
+# Timing lines of the benchmarks as "workload<TAB>measurement<TAB>ms":
+#   "<name>   <ms> ms/frame ..."  reportTiming, and refine-segments
+#   "<name>: <ms> ms, ..."        line-segment-tiled
+# Indented names get the previous line as prefix, e.g. the configuration
+# of the preprocessing benchmark.
+parse()
+{
+    awk -v OFS='\t' '
+        /^## / { workload = $2; section = ""; next }
+        / ms\/frame/ {
+            line = $0
+            sub(/ ms\/frame.*/, "", line)
+            n = split(line, w, " ")
+            if (w[n] !~ /^[0-9.]+$/)
+                next
+            name = substr(line, 1, length(line) - length(w[n]))
+            sub(/[ \t:]+$/, "", name)
+            if (name ~ /^[ \t]/) {
+                sub(/^[ \t]+/, "", name)
+                name = section " / " name
+            }
+            print workload, name, w[n]
+            next
+        }
+        /^[^:]+: +[0-9.]+ ms(,|$)/ {
+            name = $0
+            sub(/:.*/, "", name)
+            value = $0
+            sub(/^[^:]+: +/, "", value)
+            sub(/ ms.*/, "", value)
+            print workload, name, value
+            next
+        }
+        { section = $0 }
+    '
+}
+
+# Best time of every measurement over the runs.
+best()
+{
+    sort -t $'\t' -k1,1 -k2,2 -k3,3g | awk -F '\t' -v OFS='\t' '!seen[$1 FS $2]++'
+}
+
+echo "Reference build in $out/base"
+build "$out/base" -DVISION_PGO=OFF "$@"
+
+echo "Instrumented build in $out/pgo"
+profiles="$out/pgo/profiles"
+build "$out/pgo" -DVISION_PGO=GENERATE -DVISION_PGO_DIR="$profiles" "$@"
+rm -rf "$profiles"
+echo "Training"
+run "$out/pgo" > "$out/training.log"
+
+# clang writes raw profiles to merge, gcc .gcda files read as they are
+if compgen -G "$profiles/*.profraw" > /dev/null; then
+    llvm-profdata merge -output="$profiles/default.profdata" "$profiles"/*.profraw
+fi
+
+echo "Optimised build in $out/pgo"
+build "$out/pgo" -DVISION_PGO=USE -DVISION_PGO_DIR="$profiles" "$@"
+
+echo "Timing, best of $repeat runs"
+for i in $(seq "$repeat"); do run "$out/base"; done | parse | best > "$out/base.tsv"
+for i in $(seq "$repeat"); do run "$out/pgo"; done | parse | best > "$out/pgo.tsv"
+
+{
+    echo "# PGO report"
+    echo
+    echo "$(uname -srm), $(nproc) threads, best of $repeat runs, times in ms."
+    echo
+    echo "| workload | measurement | reference | PGO | speedup |"
+    echo "|---|---|---:|---:|---:|"
+    join -t $'\t' <(awk -F '\t' -v OFS='\t' '{ print $1 " | " $2, $3 }' "$out/base.tsv" | sort -t $'\t' -k1,1) \
+                  <(awk -F '\t' -v OFS='\t' '{ print $1 " | " $2, $3 }' "$out/pgo.tsv" | sort -t $'\t' -k1,1) |
+        awk -F '\t' '{ printf "| %s | %.3f | %.3f | %.2fx |\n", $1, $2, $3, ($3 > 0 ? $2 / $3 : 0) }'
+} > "$out/pgo-report.md"
+cat "$out/pgo-report.md"
@@ -0,0 +1,169 @@
+#include <opencv2/dnn.hpp>
+#include "opencv2/imgproc.hpp"
+#include <cfloat>
+#include <iostream>
+#include <vector>
+
+#include "fixtures.hpp"
+#include "../machine-learning/preprocess.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Preprocessing of one of the demos, with the sequence of OpenCV calls it
+// used before PreprocessKernel as reference.
+struct Config
+{
+    string name;
+    PreprocessSpec spec;
+    bool blob;          // reference is cv::dnn::blobFromImage
+    bool crop;          // blobFromImage crop
+};
+
+// Former process_image of the ONNX Runtime demos, with the planes split to
+// NCHW as the models expect.
+static void ortReference(const Mat& frame, const PreprocessSpec& spec, Mat& out)
+{
+    Mat image;
+    cvtColor(frame, image, COLOR_BGR2RGB);
+    double f = (double)spec.shortestEdge / min(image.cols, image.rows);
+    resize(image, image, Size(cvRound(image.cols * f), cvRound(image.rows * f)), 0, 0, INTER_AREA);
+    image = image(Rect((image.cols - spec.size.width) / 2, (image.rows - spec.size.height) / 2,
+                       spec.size.width, spec.size.height));
+    image.convertTo(image, CV_32F, spec.scale);
+    subtract(image, spec.mean * spec.scale, image);
+    divide(image, spec.std, image);
+    int sizes[] = {1, 3, spec.size.height, spec.size.width};
+    out.create(4, sizes, CV_32F);
+    vector<Mat> planes;
+    for (int c = 0; c < 3; c++)
+        planes.push_back(Mat(spec.size, CV_32F, out.ptr<float>(0, c)));
+    split(image, planes);
+}
+
+// Resize to fit, pad and convert to RGB: an 8-bit NHWC detector input.
+static void letterboxReference(const Mat& frame, const PreprocessSpec& spec, Mat& out)
+{
+    double f = min((double)spec.size.width / frame.cols, (double)spec.size.height / frame.rows);
+    Size resized(cvRound(frame.cols * f), cvRound(frame.rows * f));
+    Mat image;
+    resize(frame, image, resized);
+    int top = (spec.size.height - resized.height) / 2, left = (spec.size.width - resized.width) / 2;
+    copyMakeBorder(image, image, top, spec.size.height - resized.height - top,
+                   left, spec.size.width - resized.width - left, BORDER_CONSTANT, spec.padValue);
+    cvtColor(image, out, COLOR_BGR2RGB);
+}
+
+static Mat flat(const Mat& m)
+{
+    Mat f;
+    Mat(1, (int)(m.total() * m.channels()), m.depth(), m.data).convertTo(f, CV_32F);
+    return f;
+}
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{width    |1280|frame width}"
+                             "{height   |720|frame height}"
+                             "{iters    |20|number of timed runs, the best one is reported}"
+                             "{help    h|false|show help message}");
+    parser.about("OpenCV preprocessing sequences against the fused PreprocessKernel for the model configurations of the demos.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int iters = max(1, parser.get<int>("iters"));
+    SyntheticScene scene(SCENE_SHAPES, Size(parser.get<int>("width"), parser.get<int>("height")));
+    Mat frame;
+    scene.render(0, frame);
+
+    vector<Config> configs;
+    {
+        Config c;
+        c.name = "segmentation 500x500";
+        c.spec.size = Size(500, 500);
+        c.spec.scale = 1.0 / 255;
+        c.blob = true;
+        c.crop = false;
+        configs.push_back(c);
+
+        c.name = "open-pose 368x368";
+        c.spec.size = Size(368, 368);
+        configs.push_back(c);
+
+        c.name = "face ssd 300x300 crop";
+        c.spec.size = Size(300, 300);
+        c.spec.resize = RESIZE_CROP;
+        c.spec.scale = 1;
+        c.spec.mean = Scalar(104, 177, 123);
+        c.crop = true;
+        configs.push_back(c);
+
+        c = Config();
+        c.name = "dinov2 518x518 ort";
+        c.spec.size = Size(518, 518);
+        c.spec.resize = RESIZE_CROP;
+        c.spec.shortestEdge = 518;
+        c.spec.interpolation = INTER_AREA;
+        c.spec.mean = Scalar(0.485, 0.456, 0.406) * 255;
+        c.spec.std = Scalar(0.229, 0.224, 0.225);
+        c.spec.scale = 1.0 / 255;
+        c.spec.swapRB = true;
+        c.blob = false;
+        configs.push_back(c);
+
+        c = Config();
+        c.name = "letterbox 640x640 u8 nhwc";
+        c.spec.size = Size(640, 640);
+        c.spec.resize = RESIZE_LETTERBOX;
+        c.spec.padValue = Scalar::all(114);
+        c.spec.swapRB = true;
+        c.spec.layout = LAYOUT_NHWC;
+        c.spec.depth = CV_8U;
+        c.blob = false;
+        configs.push_back(c);
+    }
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const Config& c = configs[i];
+        Mat reference, fused;
+        double tRef = DBL_MAX, tFused = DBL_MAX;
+        for (int it = 0; it < iters; it++)
+        {
+            int64 t = getTickCount();
+            if (c.blob)
+                dnn::blobFromImage(frame, reference, c.spec.scale, c.spec.size, c.spec.mean, c.spec.swapRB, c.crop);
+            else if (c.spec.resize == RESIZE_CROP)
+                ortReference(frame, c.spec, reference);
+            else
+                letterboxReference(frame, c.spec, reference);
+            tRef = min(tRef, (getTickCount() - t) / getTickFrequency());
+        }
+
+        // compiled once, the tap tables are built by the first run
+        PreprocessKernel kernel(c.spec);
+        for (int it = 0; it < iters; it++)
+        {
+            int64 t = getTickCount();
+            kernel.run(frame, fused);
+            tFused = min(tFused, (getTickCount() - t) / getTickFrequency());
+        }
+
+        // the fixed point taps of cv::resize round differently
+        double diff = norm(flat(reference), flat(fused), NORM_INF);
+        printf("%s\n", c.name.c_str());
+        reportTiming("  opencv calls", tRef, 1);
+        reportTiming("  fused kernel", tFused, 1);
+        printf("%-28s %10.4f max difference\n", "", diff);
+    }
+    return 0;
+}
+
+/*
+Example usage:
+
+    ./build/bench-preprocess --width=1920 --height=1080
+*/
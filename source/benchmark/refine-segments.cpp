@@ -0,0 +1,87 @@
+#include "opencv2/imgproc.hpp"
+#include <iostream>
+#include <vector>
+
+#include "../machine-learning/segment-refine.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Synthetic MOG2 style mask: a few foreground blobs with shadow borders (127)
+// and salt noise, deterministic for a given frame index.
+static void makeMask(Size size, int frame, Mat& mask)
+{
+    RNG rng(frame + 1);
+    mask.create(size, CV_8UC1);
+    mask.setTo(Scalar::all(0));
+    int blobs = rng.uniform(1, 8);
+    for (int i = 0; i < blobs; i++)
+    {
+        Point c(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        Size axes(rng.uniform(10, size.width / 8), rng.uniform(10, size.height / 4));
+        double angle = rng.uniform(0., 180.);
+        ellipse(mask, c, axes + Size(6, 6), angle, 0, 360, Scalar(127), FILLED);
+        ellipse(mask, c, axes, angle, 0, 360, Scalar(255), FILLED);
+    }
+    Mat noise(size, CV_8UC1);
+    rng.fill(noise, RNG::UNIFORM, 0, 256);
+    mask.setTo(Scalar(255), noise > 250);
+}
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{width    |1280|mask width}"
+                             "{height   |720|mask height}"
+                             "{frames   |300|number of masks}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of refineSegmentsFast against the contour based refineSegments.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    Size size(parser.get<int>("width"), parser.get<int>("height"));
+    int frames = parser.get<int>("frames");
+
+    Mat img(size, CV_8UC3, Scalar::all(0));
+    Mat mask, dst, fast(size, CV_8UC3);
+    RefineBuffers buffers;
+    vector<SegmentComponent> components;
+    double tLegacy = 0, tFast = 0, iouSum = 0;
+    int compared = 0;
+
+    for (int f = 0; f < frames; f++)
+    {
+        makeMask(size, f, mask);
+
+        int64 t = getTickCount();
+        refineSegments(img, mask, dst);
+        tLegacy += (getTickCount() - t) / getTickFrequency();
+
+        t = getTickCount();
+        int largest = refineSegmentsFast(mask, buffers, components);
+        tFast += (getTickCount() - t) / getTickFrequency();
+
+        // compare the largest components, holes aside both should agree
+        fast.setTo(Scalar::all(0));
+        if (largest >= 0)
+            drawSegment(buffers, components[largest], fast, Scalar(0, 0, 255));
+        Mat a, b;
+        extractChannel(dst, a, 2);
+        extractChannel(fast, b, 2);
+        double uni = countNonZero(a | b);
+        if (uni > 0)
+        {
+            iouSum += countNonZero(a & b) / uni;
+            compared++;
+        }
+    }
+
+    cout << frames << " masks at " << size << endl;
+    cout << "refineSegments:     " << tLegacy * 1000 / frames << " ms/frame" << endl;
+    cout << "refineSegmentsFast: " << tFast * 1000 / frames << " ms/frame" << endl;
+    cout << "speedup:            " << tLegacy / tFast << "x" << endl;
+    cout << "largest blob IoU:   " << (compared ? iouSum / compared : 1.0) << endl;
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include "opencv2/video/background_segm.hpp"
+#include <iostream>
+
+#include "fixtures.hpp"
+#include "../machine-learning/segment-refine.hpp"
+
+using namespace std;
+using namespace cv;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{width    |1280|frame width}"
+                             "{height   |720|frame height}"
+                             "{frames   |300|number of frames}"
+                             "{help    h|false|show help message}");
+    parser.about("Benchmark of MOG2 background subtraction and refineSegmentsFast on synthetic people.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    int frames = parser.get<int>("frames");
+    SyntheticScene scene(SCENE_PEOPLE, Size(parser.get<int>("width"), parser.get<int>("height")));
+
+    Ptr<BackgroundSubtractorMOG2> bgsubtractor = createBackgroundSubtractorMOG2();
+    bgsubtractor->setVarThreshold(10);
+
+    FrameSource source(scene.reader(frames), 4, FrameSource::Block);
+    FrameSource::Frame frame;
+    Mat bgmask;
+    RefineBuffers buffers;
+    vector<SegmentComponent> components;
+    double tModel = 0, tRefine = 0;
+    size_t blobs = 0;
+    while (source.read(frame))
+    {
+        int64 t = getTickCount();
+        bgsubtractor->apply(frame.image, bgmask);
+        int64 t2 = getTickCount();
+        refineSegmentsFast(bgmask, buffers, components);
+        int64 t3 = getTickCount();
+        tModel += (t2 - t) / getTickFrequency();
+        tRefine += (t3 - t2) / getTickFrequency();
+        blobs += components.size();
+    }
+
+    reportTiming("mog2 apply", tModel, frames);
+    reportTiming("refineSegmentsFast", tRefine, frames);
+    cout << "components: " << blobs << endl;
+    return 0;
+}
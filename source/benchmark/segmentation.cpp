@@ -0,0 +1,81 @@
+#include <opencv2/dnn.hpp>
+#include <iostream>
+
+#include "fixtures.hpp"
+#include "../machine-learning/colorize-segmentation.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace dnn;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv,
+                             "{model    m||optional model, only the post-processing is measured without it}"
+                             "{config   c||optional model configuration}"
+                             "{scale     |0.00392|preprocess scale factor}"
+                             "{inpwidth  |500|network input width}"
+                             "{inpheight |500|network input height}"
+                             "{classes   |21|number of classes of the synthetic scores}"
+                             "{width     |1280|frame width}"
+                             "{height    |720|frame height}"
+                             "{frames    |50|number of frames}"
+                             "{help     h|false|show help message}");
+    parser.about("Benchmark of the semantic segmentation pipeline on synthetic frames.");
+    if (parser.get<bool>("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    int frames = parser.get<int>("frames");
+    Size inpSize(parser.get<int>("inpwidth"), parser.get<int>("inpheight"));
+    double scale = parser.get<double>("scale");
+    SyntheticScene scene(SCENE_SHAPES, Size(parser.get<int>("width"), parser.get<int>("height")));
+
+    Net net;
+    if (parser.has("model"))
+        net = readNet(parser.get<String>("model"), parser.get<String>("config"));
+
+    // scores used when there is no model, redrawn for every frame
+    int sizes[] = {1, parser.get<int>("classes"), inpSize.height, inpSize.width};
+    Mat synthetic(4, sizes, CV_32F), score;
+    RNG rng(42);
+
+    FrameSource source(scene.reader(frames), 4, FrameSource::Block);
+    FrameSource::Frame frame;
+    Mat blob, segm;
+    vector<Vec3b> colors;
+    double tPre = 0, tNet = 0, tPost = 0;
+    while (source.read(frame))
+    {
+        int64 t0 = getTickCount();
+        blobFromImage(frame.image, blob, scale, inpSize, Scalar(), false, false);
+        int64 t1 = getTickCount();
+        if (!net.empty())
+        {
+            net.setInput(blob);
+            score = net.forward();
+        }
+        else
+        {
+            rng.fill(synthetic, RNG::UNIFORM, 0, 1);
+            score = synthetic;
+        }
+        int64 t2 = getTickCount();
+        colorizeSegmentation(score, segm, colors);
+        resize(segm, segm, frame.image.size(), 0, 0, INTER_NEAREST);
+        addWeighted(frame.image, 0.1, segm, 0.9, 0.0, frame.image);
+        int64 t3 = getTickCount();
+
+        tPre += (t1 - t0) / getTickFrequency();
+        tNet += (t2 - t1) / getTickFrequency();
+        tPost += (t3 - t2) / getTickFrequency();
+    }
+
+    reportTiming("segmentation preprocess", tPre, frames);
+    if (!net.empty())
+        reportTiming("segmentation forward", tNet, frames);
+    reportTiming("segmentation postprocess", tPost, frames);
+    return 0;
+}
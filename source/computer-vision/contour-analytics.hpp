@@ -0,0 +1,188 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "orientation.hpp"
+
+// Descriptors computed by ContourAnalytics, combined as flags.
+enum ContourDescriptor
+{
+    CONTOUR_AREA = 1,           // always computed, used by the filter
+    CONTOUR_PERIMETER = 2,
+    CONTOUR_ORIENTATION = 4,
+    CONTOUR_HULL = 8,           // hull points, hull area and solidity
+    CONTOUR_HU = 16,            // the 7 Hu moment invariants
+    CONTOUR_ALL = 31
+};
+
+struct ContourAnalyticsParams
+{
+    bool otsu = true;                   // Otsu threshold, else the fixed one
+    double threshold = 50;
+    double minArea = 1e2, maxArea = 1e5;
+    int descriptors = CONTOUR_ALL;
+    OrientationMode orientation = ORIENTATION_POINTS;
+    int mode = cv::RETR_LIST;
+    int method = cv::CHAIN_APPROX_NONE;
+};
+
+// Struct of arrays of the contours kept by the filter, entry i of every
+// array is contour i. Arrays of descriptors that were not requested are
+// empty. The hull of contour i is hullPoints[hullOffsets[i], hullOffsets[i+1]).
+struct ContourTable
+{
+    std::vector<std::vector<cv::Point> > contours;
+    std::vector<double> area, perimeter;
+    ContourOrientations orientation;
+    std::vector<cv::Point> hullPoints;
+    std::vector<int> hullOffsets;
+    std::vector<double> hullArea, solidity;
+    std::vector<double> hu[7];
+
+    size_t size() const { return contours.size(); }
+};
+
+// Time spent in each stage of the last frame, in milliseconds.
+struct ContourStageTimes
+{
+    double threshold = 0, contours = 0, filter = 0, descriptors = 0, sink = 0;
+};
+
+// Threshold, contour extraction, area filter and descriptors of a frame as
+// one reusable stage. The filter and the descriptors run in parallel over
+// the contours, and the buffers and the table are kept between frames.
+// Drawing is left to an optional debug sink, called with the binary image
+// and the table at the end of the frame.
+class ContourAnalytics
+{
+public:
+    typedef std::function<void(const cv::Mat& binary, const ContourTable& table)> DebugSink;
+
+    explicit ContourAnalytics(const ContourAnalyticsParams& params_ = ContourAnalyticsParams()) : params(params_) {}
+
+    void setDebugSink(const DebugSink& sink_) { sink = sink_; }
+
+    // Analyse a gray or BGR image. The table is valid until the next call.
+    const ContourTable& process(const cv::Mat& image)
+    {
+        int64 t0 = cv::getTickCount();
+        if (image.channels() == 3)
+            cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        else
+            gray = image;
+        cv::threshold(gray, binary, params.threshold, 255, cv::THRESH_BINARY | (params.otsu ? cv::THRESH_OTSU : 0));
+
+        int64 t1 = cv::getTickCount();
+        cv::findContours(binary, found, params.mode, params.method);
+
+        int64 t2 = cv::getTickCount();
+        filter();
+
+        int64 t3 = cv::getTickCount();
+        describe();
+
+        int64 t4 = cv::getTickCount();
+        if (sink)
+            sink(binary, table);
+
+        int64 t5 = cv::getTickCount();
+        double ms = 1000. / cv::getTickFrequency();
+        times.threshold = (t1 - t0) * ms;
+        times.contours = (t2 - t1) * ms;
+        times.filter = (t3 - t2) * ms;
+        times.descriptors = (t4 - t3) * ms;
+        times.sink = (t5 - t4) * ms;
+        return table;
+    }
+
+    const ContourTable& lastTable() const { return table; }
+    const ContourStageTimes& lastTimes() const { return times; }
+
+private:
+    void filter()
+    {
+        areas.resize(found.size());
+        cv::parallel_for_(cv::Range(0, (int)found.size()), [&](const cv::Range& r) {
+            for (int i = r.start; i < r.end; i++)
+                areas[i] = cv::contourArea(found[i]);
+        });
+
+        // moved, not copied, the found contours are rebuilt by the next frame
+        table.contours.clear();
+        table.area.clear();
+        for (size_t i = 0; i < found.size(); i++)
+        {
+            if (areas[i] < params.minArea || params.maxArea < areas[i])
+                continue;
+            table.contours.push_back(std::move(found[i]));
+            table.area.push_back(areas[i]);
+        }
+    }
+
+    void describe()
+    {
+        const int d = params.descriptors;
+        const int n = (int)table.size();
+        table.perimeter.resize(d & CONTOUR_PERIMETER ? n : 0);
+        table.hullArea.resize(d & CONTOUR_HULL ? n : 0);
+        table.solidity.resize(d & CONTOUR_HULL ? n : 0);
+        hulls.resize(d & CONTOUR_HULL ? n : 0);
+        for (int k = 0; k < 7; k++)
+            table.hu[k].resize(d & CONTOUR_HU ? n : 0);
+
+        if (d & CONTOUR_ORIENTATION)
+            estimateOrientations(table.contours, table.orientation, params.orientation);
+        else
+            table.orientation.resize(0);
+
+        if (d & (CONTOUR_PERIMETER | CONTOUR_HULL | CONTOUR_HU))
+        {
+            cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+                for (int i = r.start; i < r.end; i++)
+                {
+                    const std::vector<cv::Point>& c = table.contours[i];
+                    if (d & CONTOUR_PERIMETER)
+                        table.perimeter[i] = cv::arcLength(c, true);
+                    if (d & CONTOUR_HULL)
+                    {
+                        cv::convexHull(c, hulls[i]);
+                        table.hullArea[i] = cv::contourArea(hulls[i]);
+                        table.solidity[i] = table.hullArea[i] > 0 ? table.area[i] / table.hullArea[i] : 0;
+                    }
+                    if (d & CONTOUR_HU)
+                    {
+                        double hu[7];
+                        cv::HuMoments(cv::moments(c), hu);
+                        for (int k = 0; k < 7; k++)
+                            table.hu[k][i] = hu[k];
+                    }
+                }
+            });
+        }
+
+        // one flat buffer for all the hulls
+        table.hullPoints.clear();
+        table.hullOffsets.clear();
+        if (d & CONTOUR_HULL)
+        {
+            table.hullOffsets.push_back(0);
+            for (int i = 0; i < n; i++)
+            {
+                table.hullPoints.insert(table.hullPoints.end(), hulls[i].begin(), hulls[i].end());
+                table.hullOffsets.push_back((int)table.hullPoints.size());
+            }
+        }
+    }
+
+    ContourAnalyticsParams params;
+    DebugSink sink;
+    cv::Mat gray, binary;
+    std::vector<std::vector<cv::Point> > found, hulls;
+    std::vector<double> areas;
+    ContourTable table;
+    ContourStageTimes times;
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace hull_batch {
+
+static const int kRadixBits = 11;
+static const int kRadixBuckets = 1 << kRadixBits;
+
+// Per thread buffers, reused over the sets of a range.
+struct Scratch
+{
+    std::vector<uint64_t> keys, tmp;
+    std::vector<int> counts;
+    std::vector<cv::Point> sorted, chain;
+};
+
+inline int bitsFor(uint32_t range)
+{
+    int bits = 0;
+    while (bits < 32 && (range >> bits) != 0)
+        bits++;
+    return bits;
+}
+
+inline int64_t cross(const cv::Point& o, const cv::Point& a, const cv::Point& b)
+{
+    return ((int64_t)a.x - o.x) * ((int64_t)b.y - o.y) - ((int64_t)a.y - o.y) * ((int64_t)b.x - o.x);
+}
+
+// Sort the points of one set by (x, y) without duplicates into s.sorted.
+inline void sortPoints(const cv::Point* pts, int n, Scratch& s)
+{
+    int minX = pts[0].x, maxX = pts[0].x, minY = pts[0].y, maxY = pts[0].y;
+    for (int i = 1; i < n; i++)
+    {
+        minX = std::min(minX, pts[i].x);
+        maxX = std::max(maxX, pts[i].x);
+        minY = std::min(minY, pts[i].y);
+        maxY = std::max(maxY, pts[i].y);
+    }
+    // only the bits spanned by the set are sorted on
+    int yBits = bitsFor((uint32_t)((int64_t)maxY - minY));
+    int bits = bitsFor((uint32_t)((int64_t)maxX - minX)) + yBits;
+
+    s.keys.resize(n);
+    for (int i = 0; i < n; i++)
+        s.keys[i] = ((uint64_t)(uint32_t)((int64_t)pts[i].x - minX) << yBits) | (uint32_t)((int64_t)pts[i].y - minY);
+
+    if (n < 256)
+        std::sort(s.keys.begin(), s.keys.end());    // the bucket counts would dominate
+    else
+    {
+        s.tmp.resize(n);
+        s.counts.resize(kRadixBuckets);
+        for (int shift = 0; shift < bits; shift += kRadixBits)
+        {
+            std::fill(s.counts.begin(), s.counts.end(), 0);
+            for (int i = 0; i < n; i++)
+                s.counts[(s.keys[i] >> shift) & (kRadixBuckets - 1)]++;
+            int sum = 0;
+            for (int b = 0; b < kRadixBuckets; b++)
+            {
+                int c = s.counts[b];
+                s.counts[b] = sum;
+                sum += c;
+            }
+            for (int i = 0; i < n; i++)
+                s.tmp[s.counts[(s.keys[i] >> shift) & (kRadixBuckets - 1)]++] = s.keys[i];
+            s.keys.swap(s.tmp);
+        }
+    }
+
+    s.sorted.clear();
+    const uint64_t yMask = yBits == 0 ? 0 : (~0ULL >> (64 - yBits));
+    for (int i = 0; i < n; i++)
+    {
+        if (i > 0 && s.keys[i] == s.keys[i - 1])
+            continue;
+        s.sorted.push_back(cv::Point((int)((int64_t)(s.keys[i] >> yBits) + minX),
+                                     (int)((int64_t)(s.keys[i] & yMask) + minY)));
+    }
+}
+
+// Andrew's monotone chain over s.sorted into s.chain.
+inline void monotoneChain(Scratch& s)
+{
+    const std::vector<cv::Point>& p = s.sorted;
+    int n = (int)p.size();
+    s.chain.resize(2 * n);
+    if (n < 3)
+    {
+        s.chain.assign(p.begin(), p.end());
+        return;
+    }
+    int k = 0;
+    for (int i = 0; i < n; i++)
+    {
+        while (k >= 2 && cross(s.chain[k - 2], s.chain[k - 1], p[i]) <= 0)
+            k--;
+        s.chain[k++] = p[i];
+    }
+    for (int i = n - 2, lower = k + 1; i >= 0; i--)
+    {
+        while (k >= lower && cross(s.chain[k - 2], s.chain[k - 1], p[i]) <= 0)
+            k--;
+        s.chain[k++] = p[i];
+    }
+    s.chain.resize(k - 1);      // the last point is the first one
+}
+
+} // namespace hull_batch
+
+// Convex hulls of many point sets in one call.
+//
+// The sets are stored back to back in one point buffer, set i being
+// points[offsets[i], offsets[i+1]), and the hulls are written the same way.
+// Each set is sorted with an LSD radix sort on a packed (x, y) key and its
+// hull built with Andrew's monotone chain, in parallel over the sets.
+// Hulls are counter-clockwise in a y-up frame, like cv::convexHull with
+// clockwise = false, start at the lowest x (then lowest y) point, and
+// have no collinear points.
+inline void convexHullBatch(const std::vector<cv::Point>& points, const std::vector<int>& offsets,
+                            std::vector<cv::Point>& hullPoints, std::vector<int>& hullOffsets)
+{
+    using namespace hull_batch;
+    CV_Assert(!offsets.empty() && offsets.back() == (int)points.size());
+    const int sets = (int)offsets.size() - 1;
+
+    // a hull is never larger than its set: hulls first go to the same
+    // offsets of a scratch buffer, then are packed
+    std::vector<cv::Point> spread(points.size());
+    std::vector<int> sizes(sets);
+    cv::parallel_for_(cv::Range(0, sets), [&](const cv::Range& r) {
+        Scratch s;
+        for (int i = r.start; i < r.end; i++)
+        {
+            int n = offsets[i + 1] - offsets[i];
+            if (n <= 0)
+            {
+                sizes[i] = 0;
+                continue;
+            }
+            sortPoints(&points[offsets[i]], n, s);
+            monotoneChain(s);
+            std::copy(s.chain.begin(), s.chain.end(), spread.begin() + offsets[i]);
+            sizes[i] = (int)s.chain.size();
+        }
+    }, std::max(1.0, sets / 64.0));
+
+    hullOffsets.resize(sets + 1);
+    hullOffsets[0] = 0;
+    for (int i = 0; i < sets; i++)
+        hullOffsets[i + 1] = hullOffsets[i] + sizes[i];
+    hullPoints.resize(hullOffsets[sets]);
+    for (int i = 0; i < sets; i++)
+        std::copy(spread.begin() + offsets[i], spread.begin() + offsets[i] + sizes[i],
+                  hullPoints.begin() + hullOffsets[i]);
+}
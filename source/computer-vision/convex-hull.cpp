@@ -2,13 +2,46 @@
 #include "opencv2/highgui.hpp"
 #include <iostream>
 
+#include "incremental-hull.hpp"
+
 static void help(char** argv) {
     std::cout << "\nThis sample program demonstrates the use of the convexHull() function\n";
+    std::cout << "With --incremental, points are added one at a time to an incremental hull\n";
+}
+
+// Trajectory envelope: a random walk, the hull is updated on each new point
+// instead of being recomputed.
+static void runIncremental(cv::Mat& img, cv::RNG& rng)
+{
+    IncrementalHull hull;
+    std::vector<cv::Point> trail, vertices;
+    cv::Point2f pos(img.cols / 2.f, img.rows / 2.f), vel(0, 0);
+    for(;;)
+    {
+        vel = vel * 0.9f + cv::Point2f(rng.gaussian(1.5), rng.gaussian(1.5));
+        pos.x = std::min(std::max(pos.x + vel.x, 0.f), img.cols - 1.f);
+        pos.y = std::min(std::max(pos.y + vel.y, 0.f), img.rows - 1.f);
+        cv::Point pt(cvRound(pos.x), cvRound(pos.y));
+        trail.push_back(pt);
+        hull.insert(pt);
+
+        img = cv::Scalar::all(0);
+        cv::polylines(img, trail, false, cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
+        hull.points(vertices);
+        cv::polylines(img, vertices, true, cv::Scalar(0, 255, 0), 1, cv::LINE_AA);
+        cv::putText(img, cv::format("points %d  hull %d  area %.0f", (int)trail.size(), (int)hull.size(), hull.area()),
+                    cv::Point(10, 20), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar::all(255));
+        cv::imshow("hull", img);
+
+        char key = (char)cv::waitKey(15);
+        if( key == 27 || key == 'q' || key == 'Q' ) // 'ESC'
+            break;
+    }
 }
 
 int main(int argc, char** argv)
 {
-    cv::CommandLineParser parser(argc, argv, "{help h||}");
+    cv::CommandLineParser parser(argc, argv, "{help h||}{incremental||}");
     if (parser.has("help"))
     {
         help(argv);
@@ -17,6 +50,12 @@ int main(int argc, char** argv)
     cv::Mat img(700, 700, CV_8UC3);
     cv::RNG& rng = cv::theRNG();
 
+    if (parser.has("incremental"))
+    {
+        runIncremental(img, rng);
+        return 0;
+    }
+
     for(;;)
     {
         int i, count = (unsigned)rng%100 + 1;
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <vector>
+
+struct FaceMatch
+{
+    int index;          // row of the gallery
+    int label;
+    float distance;     // L2 distance, or 1 - cosine similarity
+};
+
+// Nearest neighbour recognition in the eigenspace of a PCA.
+//
+// Samples are projected in batches with one GEMM. The gallery projections are
+// stored with their rows padded to a multiple of kLanes floats, so the
+// distance kernel runs on whole SIMD vectors without tails. Both metrics
+// reduce to dot products: L2 uses the precomputed squared norms of the
+// gallery, cosine normalizes the gallery rows once when they are added.
+class EigenfaceRecognizer
+{
+public:
+    enum Metric
+    {
+        L2,
+        COSINE
+    };
+
+    static const int kLanes = 16;   // widest SIMD register in floats (AVX-512)
+
+    EigenfaceRecognizer(const cv::PCA& pca_, Metric metric_ = L2) : pca(pca_), metric(metric_)
+    {
+        CV_Assert(!pca.eigenvectors.empty() && pca.eigenvectors.type() == CV_32F);
+        dims = pca.eigenvectors.rows;
+        stride = (dims + kLanes - 1) / kLanes * kLanes;
+        meanProjection = pca.mean * pca.eigenvectors.t();
+    }
+
+    int dimensions() const { return dims; }
+    int gallerySize() const { return (int)labels.size(); }
+
+    // Room for at least n gallery entries. The gallery grows geometrically,
+    // call it before adding many small batches of a known total.
+    void reserve(int n)
+    {
+        if (n <= gallery.rows)
+            return;
+        int capacity = std::max(n, std::max(2 * gallery.rows, 64));
+        // zeroed so the padding of the rows stays 0, rows stay 64 byte aligned
+        cv::Mat grown = cv::Mat::zeros(capacity, stride, CV_32F);
+        int size = gallerySize();
+        if (size > 0)
+            gallery.rowRange(0, size).copyTo(grown.rowRange(0, size));
+        gallery = grown;
+        norms.reserve(capacity);
+        labels.reserve(capacity);
+    }
+
+    // Project the rows of samples, (x - mean) * W^T as x * W^T - mean * W^T,
+    // into the first dimensions() columns of coeffs.
+    void project(const cv::Mat& samples, cv::Mat& coeffs) const
+    {
+        CV_Assert(samples.type() == CV_32F && samples.cols == pca.eigenvectors.cols);
+        cv::gemm(samples, pca.eigenvectors, 1.0, cv::noArray(), 0.0, coeffs, cv::GEMM_2_T);
+        for (int i = 0; i < coeffs.rows; i++)
+        {
+            cv::Mat row_i = coeffs.row(i);
+            row_i -= meanProjection;
+        }
+    }
+
+    // Add samples (one image per row) to the gallery.
+    void add(const cv::Mat& samples, const std::vector<int>& sampleLabels)
+    {
+        cv::Mat coeffs;
+        project(samples, coeffs);
+        addProjected(coeffs, sampleLabels);
+    }
+
+    // Add already projected samples, dimensions() columns each.
+    void addProjected(const cv::Mat& coeffs, const std::vector<int>& sampleLabels)
+    {
+        CV_Assert(coeffs.type() == CV_32F && coeffs.cols == dims && (size_t)coeffs.rows == sampleLabels.size());
+        int first = gallerySize();
+        reserve(first + coeffs.rows);
+
+        for (int i = 0; i < coeffs.rows; i++)
+        {
+            float* g = gallery.ptr<float>(first + i);
+            const float* c = coeffs.ptr<float>(i);
+            double sq = 0;
+            for (int j = 0; j < dims; j++)
+                sq += (double)c[j] * c[j];
+            float scale = metric == COSINE && sq > 0 ? (float)(1 / std::sqrt(sq)) : 1.f;
+            for (int j = 0; j < dims; j++)
+                g[j] = c[j] * scale;
+            norms.push_back(metric == COSINE ? 1.f : (float)sq);
+        }
+        labels.insert(labels.end(), sampleLabels.begin(), sampleLabels.end());
+    }
+
+    // k nearest gallery entries of each query image, closest first.
+    void match(const cv::Mat& queries, int k, std::vector<std::vector<FaceMatch> >& matches) const
+    {
+        cv::Mat coeffs;
+        project(queries, coeffs);
+        matchProjected(coeffs, k, matches);
+    }
+
+    void matchProjected(const cv::Mat& coeffs, int k, std::vector<std::vector<FaceMatch> >& matches) const
+    {
+        CV_Assert(coeffs.type() == CV_32F && coeffs.cols == dims && k > 0);
+        matches.assign(coeffs.rows, std::vector<FaceMatch>());
+        k = std::min(k, gallerySize());
+        if (k == 0)
+            return;
+
+        cv::parallel_for_(cv::Range(0, coeffs.rows), [&](const cv::Range& r) {
+            std::vector<float> query(stride, 0.f);
+            float dots[4];
+            for (int q = r.start; q < r.end; q++)
+            {
+                const float* c = coeffs.ptr<float>(q);
+                double sq = 0;
+                for (int j = 0; j < dims; j++)
+                    sq += (double)c[j] * c[j];
+                float scale = metric == COSINE && sq > 0 ? (float)(1 / std::sqrt(sq)) : 1.f;
+                for (int j = 0; j < dims; j++)
+                    query[j] = c[j] * scale;
+                float qq = metric == COSINE ? 1.f : (float)sq;
+
+                // max-heap on the distance keeps the k best
+                std::priority_queue<std::pair<float, int> > best;
+                int n = gallerySize(), i = 0;
+                for (; i <= n - 4; i += 4)
+                {
+                    dot4(query.data(), i, dots);
+                    for (int t = 0; t < 4; t++)
+                        push(best, k, distance(qq, norms[i + t], dots[t]), i + t);
+                }
+                for (; i < n; i++)
+                    push(best, k, distance(qq, norms[i], dot(query.data(), gallery.ptr<float>(i))), i);
+
+                std::vector<FaceMatch>& out = matches[q];
+                out.resize(best.size());
+                for (int j = (int)best.size() - 1; j >= 0; j--)
+                {
+                    FaceMatch m;
+                    m.index = best.top().second;
+                    m.label = labels[m.index];
+                    m.distance = best.top().first;
+                    out[j] = m;
+                    best.pop();
+                }
+            }
+        });
+    }
+
+private:
+    float distance(float qq, float gg, float dot) const
+    {
+        if (metric == COSINE)
+            return 1.f - dot;
+        return std::sqrt(std::max(qq + gg - 2 * dot, 0.f));
+    }
+
+    static void push(std::priority_queue<std::pair<float, int> >& best, int k, float d, int index)
+    {
+        if ((int)best.size() < k)
+            best.push(std::make_pair(d, index));
+        else if (d < best.top().first)
+        {
+            best.pop();
+            best.push(std::make_pair(d, index));
+        }
+    }
+
+    float dot(const float* a, const float* b) const
+    {
+        float s = 0;
+        for (int j = 0; j < dims; j++)
+            s += a[j] * b[j];
+        return s;
+    }
+
+    // Dot products of the query with gallery rows i..i+3, each query vector
+    // is loaded once for the four rows.
+    void dot4(const float* query, int i, float* out) const
+    {
+        const float* g0 = gallery.ptr<float>(i);
+        const float* g1 = gallery.ptr<float>(i + 1);
+        const float* g2 = gallery.ptr<float>(i + 2);
+        const float* g3 = gallery.ptr<float>(i + 3);
+        int j = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        if (stride % lanes == 0)
+        {
+            cv::v_float32 s0 = cv::vx_setzero_f32(), s1 = cv::vx_setzero_f32();
+            cv::v_float32 s2 = cv::vx_setzero_f32(), s3 = cv::vx_setzero_f32();
+            for (; j < stride; j += lanes)
+            {
+                // gallery rows are 64 byte aligned: cv::Mat data and stride
+                cv::v_float32 q = cv::vx_load(query + j);
+                s0 = cv::v_fma(q, cv::vx_load_aligned(g0 + j), s0);
+                s1 = cv::v_fma(q, cv::vx_load_aligned(g1 + j), s1);
+                s2 = cv::v_fma(q, cv::vx_load_aligned(g2 + j), s2);
+                s3 = cv::v_fma(q, cv::vx_load_aligned(g3 + j), s3);
+            }
+            out[0] = cv::v_reduce_sum(s0);
+            out[1] = cv::v_reduce_sum(s1);
+            out[2] = cv::v_reduce_sum(s2);
+            out[3] = cv::v_reduce_sum(s3);
+            return;
+        }
+#endif
+        out[0] = out[1] = out[2] = out[3] = 0;
+        for (; j < dims; j++)
+        {
+            out[0] += query[j] * g0[j];
+            out[1] += query[j] * g1[j];
+            out[2] += query[j] * g2[j];
+            out[3] += query[j] * g3[j];
+        }
+    }
+
+    cv::PCA pca;
+    Metric metric;
+    int dims, stride;
+    cv::Mat meanProjection;         // 1 x dims
+    cv::Mat gallery;                // capacity x stride, zero padded, gallerySize() rows used
+    std::vector<float> norms;       // squared norms of the gallery rows
+    std::vector<int> labels;
+};
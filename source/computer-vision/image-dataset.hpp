@@ -0,0 +1,245 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Packed cache of a decoded grayscale image list, one CV_32F row per image.
+//
+//   header | DatasetCacheHeader, 64 bytes
+//   rows   | rows x cols float, row-major, starting at dataOffset
+//
+// listHash identifies the list (paths, file sizes, modification times and
+// inodes) the cache was built from, a cache built from another list, or after
+// one of its files was replaced, is rebuilt.
+struct DatasetCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t rows;
+    uint32_t cols;
+    uint32_t imageRows;
+    uint32_t imageCols;
+    uint32_t reserved0;
+    uint64_t listHash;
+    uint64_t dataOffset;
+    uint32_t reserved[4];
+};
+static_assert(sizeof(DatasetCacheHeader) == 64, "DatasetCacheHeader must stay 64 bytes");
+
+static const char kDatasetCacheMagic[4] = {'I', 'M', 'G', 'M'};
+static const uint32_t kDatasetCacheVersion = 2;
+
+namespace image_dataset {
+
+// FNV-1a over the paths and the size, modification time and inode of the
+// files. Same-size images are common, the size alone misses a replaced file.
+inline uint64_t listHash(const std::vector<std::string>& paths)
+{
+    uint64_t h = 1469598103934665603ULL;
+    auto mix = [&h](const void* p, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            h = (h ^ ((const unsigned char*)p)[i]) * 1099511628211ULL;
+    };
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        struct stat st;
+        int64_t file[3] = {-1, -1, -1};     // size, mtime, inode
+        if (stat(paths[i].c_str(), &st) == 0)
+        {
+            file[0] = (int64_t)st.st_size;
+            file[1] = (int64_t)st.st_mtime;
+            file[2] = (int64_t)st.st_ino;
+        }
+        mix(paths[i].data(), paths[i].size() + 1);
+        mix(file, sizeof(file));
+    }
+    return h;
+}
+
+} // namespace image_dataset
+
+// Image list decoded into a rows x (width * height) CV_32F matrix.
+//
+// Without a cache path the images are decoded in parallel into one matrix.
+// With one, a valid cache is memory mapped and nothing is decoded; otherwise
+// the images are decoded in chunks appended to the cache, which is then
+// mapped, so building it needs memory for one chunk only. The mapping is
+// private: writing to data() never reaches the file.
+class ImageDataset
+{
+public:
+    // Decode the images in parallel, they must all have the same size.
+    static cv::Mat decode(const std::vector<std::string>& paths, cv::Size& imageSize)
+    {
+        CV_Assert(!paths.empty());
+        cv::Mat first = cv::imread(paths[0], cv::IMREAD_GRAYSCALE);
+        if (first.empty())
+            CV_Error(cv::Error::StsError, "Can not read " + paths[0]);
+        imageSize = first.size();
+        cv::Mat dst((int)paths.size(), (int)first.total(), CV_32F);
+        decodeInto(paths, 0, paths.size(), imageSize, dst);
+        return dst;
+    }
+
+    explicit ImageDataset(const std::vector<std::string>& paths, const std::string& cachePath = "",
+                          size_t chunkRows = 1024)
+        : base(MAP_FAILED), size(0), cached(false)
+    {
+        CV_Assert(!paths.empty());
+        if (cachePath.empty())
+        {
+            matrix = decode(paths, imgSize);
+            return;
+        }
+        uint64_t hash = image_dataset::listHash(paths);
+        if (map(cachePath, hash))
+        {
+            cached = true;
+            return;
+        }
+        build(paths, cachePath, hash, std::max<size_t>(chunkRows, 1));
+        if (!map(cachePath, hash))
+            CV_Error(cv::Error::StsError, "Can not map " + cachePath);
+    }
+
+    ~ImageDataset()
+    {
+        if (base != MAP_FAILED)
+            munmap(base, size);
+    }
+
+    ImageDataset(const ImageDataset&) = delete;
+    ImageDataset& operator=(const ImageDataset&) = delete;
+
+    // One row per image, valid as long as the dataset is alive.
+    const cv::Mat& data() const { return matrix; }
+    cv::Size imageSize() const { return imgSize; }
+    // True when the rows were mapped from an existing cache.
+    bool fromCache() const { return cached; }
+
+private:
+    static void decodeInto(const std::vector<std::string>& paths, size_t begin, size_t end,
+                           cv::Size imageSize, cv::Mat& dst)
+    {
+        // errors are reported after the loop, not thrown from the workers
+        std::atomic<int64_t> failed(-1);
+        cv::parallel_for_(cv::Range((int)begin, (int)end), [&](const cv::Range& r) {
+            for (int i = r.start; i < r.end; i++)
+            {
+                cv::Mat image = cv::imread(paths[i], cv::IMREAD_GRAYSCALE);
+                if (image.size() != imageSize)
+                {
+                    failed = i;
+                    continue;
+                }
+                cv::Mat row_i = dst.row(i - (int)begin);
+                image.reshape(1, 1).convertTo(row_i, CV_32F);
+            }
+        });
+        if (failed >= 0)
+            CV_Error(cv::Error::StsError, "Can not read " + paths[(size_t)failed] + " or its size differs");
+    }
+
+    bool map(const std::string& path, uint64_t hash)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        fstat(fd, &st);
+        size = (size_t)st.st_size;
+        base = size >= sizeof(DatasetCacheHeader) ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+                                                  : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED)
+            return false;
+
+        const DatasetCacheHeader* header = (const DatasetCacheHeader*)base;
+        if (memcmp(header->magic, kDatasetCacheMagic, sizeof(header->magic)) != 0 ||
+            header->version != kDatasetCacheVersion || header->listHash != hash ||
+            header->dataOffset + header->rows * header->cols * sizeof(float) > size)
+        {
+            munmap(base, size);
+            base = MAP_FAILED;
+            return false;
+        }
+        imgSize = cv::Size((int)header->imageCols, (int)header->imageRows);
+        matrix = cv::Mat((int)header->rows, (int)header->cols, CV_32F, (char*)base + header->dataOffset);
+        return true;
+    }
+
+    void build(const std::vector<std::string>& paths, const std::string& path, uint64_t hash, size_t chunkRows)
+    {
+        // written next to the cache and renamed, an interrupted build leaves no partial cache
+        std::string temp = path + ".tmp";
+        FILE* file = fopen(temp.c_str(), "wb");
+        if (!file)
+            CV_Error(cv::Error::StsError, "Can not open " + temp + " for writing");
+
+        DatasetCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kDatasetCacheMagic, sizeof(header.magic));
+        header.version = kDatasetCacheVersion;
+        header.rows = paths.size();
+        header.listHash = hash;
+        header.dataOffset = sizeof(header);
+
+        cv::Mat chunk;
+        try
+        {
+            for (size_t begin = 0; begin < paths.size(); begin += chunkRows)
+            {
+                size_t end = std::min(paths.size(), begin + chunkRows);
+                if (begin == 0)
+                {
+                    cv::Mat first = cv::imread(paths[0], cv::IMREAD_GRAYSCALE);
+                    if (first.empty())
+                        CV_Error(cv::Error::StsError, "Can not read " + paths[0]);
+                    imgSize = first.size();
+                    header.cols = (uint32_t)first.total();
+                    header.imageRows = (uint32_t)first.rows;
+                    header.imageCols = (uint32_t)first.cols;
+                    if (fwrite(&header, sizeof(header), 1, file) != 1)
+                        CV_Error(cv::Error::StsError, "Failed to write " + temp);
+                }
+                chunk.create((int)(end - begin), (int)header.cols, CV_32F);
+                decodeInto(paths, begin, end, imgSize, chunk);
+                if (fwrite(chunk.ptr(), chunk.elemSize() * header.cols, chunk.rows, file) != (size_t)chunk.rows)
+                    CV_Error(cv::Error::StsError, "Failed to write " + temp);
+            }
+        }
+        catch (...)
+        {
+            fclose(file);
+            remove(temp.c_str());
+            throw;
+        }
+        // buffered rows are written by fclose, a full disk shows up here
+        if (fclose(file) != 0)
+        {
+            remove(temp.c_str());
+            CV_Error(cv::Error::StsError, "Failed to write " + temp);
+        }
+        if (rename(temp.c_str(), path.c_str()) != 0)
+            CV_Error(cv::Error::StsError, "Can not rename " + temp + " to " + path);
+    }
+
+    cv::Mat matrix;
+    cv::Size imgSize;
+    void* base;
+    size_t size;
+    bool cached;
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <vector>
+
+namespace incremental_hull {
+
+inline int64_t cross(int64_t ox, int64_t oy, int64_t ax, int64_t ay, int64_t bx, int64_t by)
+{
+    return (ax - ox) * (by - oy) - (ay - oy) * (bx - ox);
+}
+
+// Upper chain of a hull, x -> y, turning clockwise from left to right. The
+// lower chain is the upper chain of the points with y negated. The shoelace
+// sum of the chain is kept up to date for the area.
+class Chain
+{
+public:
+    typedef std::map<int, int>::const_iterator const_iterator;
+
+    Chain() : shoelace(0) {}
+
+    bool insert(int x, int y)
+    {
+        auto it = pts.lower_bound(x);
+        if (it != pts.end() && it->first == x)
+        {
+            // a point above a vertex is outside
+            if (it->second >= y)
+                return false;
+            it = erase(it);
+        }
+        else if (it != pts.end() && it != pts.begin())
+        {
+            auto left = std::prev(it);
+            if (cross(left->first, left->second, it->first, it->second, x, y) <= 0)
+                return false;
+        }
+
+        it = pts.emplace_hint(it, x, y);
+        if (it != pts.begin() && std::next(it) != pts.end())
+            shoelace -= term(std::prev(it), std::next(it));
+        if (it != pts.begin())
+            shoelace += term(std::prev(it), it);
+        if (std::next(it) != pts.end())
+            shoelace += term(it, std::next(it));
+
+        // neighbours that are not convex any more
+        while (std::next(it) != pts.end() && std::next(std::next(it)) != pts.end())
+        {
+            auto a = std::next(it), b = std::next(a);
+            if (cross(x, y, a->first, a->second, b->first, b->second) < 0)
+                break;
+            erase(a);
+        }
+        while (it != pts.begin() && std::prev(it) != pts.begin())
+        {
+            auto a = std::prev(it), b = std::prev(a);
+            if (cross(b->first, b->second, a->first, a->second, x, y) < 0)
+                break;
+            erase(a);
+        }
+        return true;
+    }
+
+    // True when (x, y) is on or below the chain, within its x range.
+    bool below(int x, int y) const
+    {
+        auto right = pts.lower_bound(x);
+        if (right == pts.end())
+            return false;
+        if (right->first == x)
+            return y <= right->second;
+        if (right == pts.begin())
+            return false;
+        auto left = std::prev(right);
+        return cross(left->first, left->second, right->first, right->second, x, y) <= 0;
+    }
+
+    bool empty() const { return pts.empty(); }
+    size_t size() const { return pts.size(); }
+    int64_t shoelaceSum() const { return shoelace; }
+    const_iterator begin() const { return pts.begin(); }
+    const_iterator end() const { return pts.end(); }
+    std::map<int, int>::const_reverse_iterator rbegin() const { return pts.rbegin(); }
+    std::map<int, int>::const_reverse_iterator rend() const { return pts.rend(); }
+
+private:
+    static int64_t term(const_iterator a, const_iterator b)
+    {
+        return (int64_t)a->first * b->second - (int64_t)b->first * a->second;
+    }
+
+    std::map<int, int>::iterator erase(std::map<int, int>::iterator it)
+    {
+        if (it != pts.begin())
+            shoelace -= term(std::prev(it), it);
+        if (std::next(it) != pts.end())
+            shoelace -= term(it, std::next(it));
+        if (it != pts.begin() && std::next(it) != pts.end())
+            shoelace += term(std::prev(it), std::next(it));
+        return pts.erase(it);
+    }
+
+    std::map<int, int> pts;
+    int64_t shoelace;
+};
+
+} // namespace incremental_hull
+
+// Convex hull of a growing point set. Each point is inserted in O(log n)
+// amortized into the upper and lower chains kept in balanced trees (two
+// std::map sorted by x), points inside the hull are rejected in O(log n).
+//
+// contains() is O(log n) and area() O(1), the shoelace sums of the chains
+// being updated on insertion. extremal() walks one chain, O(h) for h hull
+// vertices. Coordinates are in a y-up frame, as for cv::convexHull.
+class IncrementalHull
+{
+public:
+    // Returns true when the hull changed.
+    bool insert(const cv::Point& p)
+    {
+        bool upperChanged = upper.insert(p.x, p.y);
+        bool lowerChanged = lower.insert(p.x, -p.y);
+        return upperChanged || lowerChanged;
+    }
+
+    bool empty() const { return upper.empty(); }
+
+    // Number of vertices of the hull.
+    size_t size() const
+    {
+        if (upper.empty())
+            return 0;
+        // the chains share their end points, unless they are vertical edges
+        size_t n = upper.size() + lower.size();
+        n -= upper.begin()->second == -lower.begin()->second ? 1 : 0;
+        n -= upper.rbegin()->second == -lower.rbegin()->second ? 1 : 0;
+        return std::max<size_t>(n, 1);
+    }
+
+    // True when p is inside or on the hull.
+    bool contains(const cv::Point& p) const
+    {
+        return !upper.empty() && upper.below(p.x, p.y) && lower.below(p.x, -p.y);
+    }
+
+    double area() const
+    {
+        if (upper.empty())
+            return 0;
+        // lower chain left to right, right edge, upper chain right to left, left edge
+        int64_t xl = upper.begin()->first, xr = upper.rbegin()->first;
+        int64_t twice = -lower.shoelaceSum() - upper.shoelaceSum();
+        twice += xr * (upper.rbegin()->second + lower.rbegin()->second);
+        twice -= xl * (upper.begin()->second + lower.begin()->second);
+        return 0.5 * (double)twice;
+    }
+
+    // Vertex of the hull maximizing dot(direction, p).
+    cv::Point extremal(const cv::Point2d& direction) const
+    {
+        CV_Assert(!empty());
+        // the maximum is on the chain facing the direction
+        bool up = direction.y >= 0;
+        const incremental_hull::Chain& chain = up ? upper : lower;
+        cv::Point best;
+        double bestDot = -DBL_MAX;
+        for (auto it = chain.begin(); it != chain.end(); ++it)
+        {
+            cv::Point p(it->first, up ? it->second : -it->second);
+            double d = direction.x * p.x + direction.y * p.y;
+            if (d > bestDot)
+            {
+                bestDot = d;
+                best = p;
+            }
+        }
+        return best;
+    }
+
+    // Vertices counter-clockwise, from the lowest x (then lowest y) point.
+    void points(std::vector<cv::Point>& hull) const
+    {
+        hull.clear();
+        for (auto it = lower.begin(); it != lower.end(); ++it)
+            hull.push_back(cv::Point(it->first, -it->second));
+        for (auto it = upper.rbegin(); it != upper.rend(); ++it)
+        {
+            cv::Point p(it->first, it->second);
+            if (p != hull.back() && p != hull.front())
+                hull.push_back(p);
+        }
+    }
+
+private:
+    incremental_hull::Chain upper, lower;
+};
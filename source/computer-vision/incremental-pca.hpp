@@ -0,0 +1,146 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// PCA updated one mini-batch at a time (Ross et al., "Incremental Learning
+// for Robust Visual Tracking", 2008), so the full data matrix never has to be
+// in memory. Only the mean, a truncated basis and its singular values are
+// kept, i.e. (k + 1) x d values for k components of dimension d.
+//
+// Each update decomposes the previous basis scaled by its singular values,
+// the centered batch and a mean correction row, stacked into a
+// (k + m + 1) x d matrix. The decomposition goes through its small
+// (k + m + 1)^2 Gram matrix, so the cost is linear in d.
+class IncrementalPCA
+{
+public:
+    explicit IncrementalPCA(int maxComponents_) : maxComponents(maxComponents_), seen(0), sumSquares(0)
+    {
+        CV_Assert(maxComponents > 0);
+    }
+
+    // Add a batch of samples, one per row.
+    void partialFit(const cv::Mat& batch)
+    {
+        CV_Assert(batch.channels() == 1 && batch.rows > 0);
+        CV_Assert(seen == 0 || batch.cols == mean.cols);
+
+        cv::Mat x;
+        batch.convertTo(x, CV_64F);
+        double n = (double)seen, m = (double)x.rows;
+
+        cv::Mat batchMean;
+        cv::reduce(x, batchMean, 0, cv::REDUCE_AVG, CV_64F);
+        for (int i = 0; i < x.rows; i++)
+        {
+            cv::Mat row_i = x.row(i);
+            row_i -= batchMean;
+        }
+
+        cv::Mat a;
+        if (seen == 0)
+        {
+            mean = cv::Mat::zeros(1, x.cols, CV_64F);
+            sumSquares = cv::norm(x, cv::NORM_L2SQR);
+            a = x;
+        }
+        else
+        {
+            cv::Mat delta = mean - batchMean;
+            double correction = n * m / (n + m);
+            sumSquares += cv::norm(x, cv::NORM_L2SQR) + correction * cv::norm(delta, cv::NORM_L2SQR);
+
+            int k = components.rows;
+            a.create(k + x.rows + 1, x.cols, CV_64F);
+            for (int i = 0; i < k; i++)
+            {
+                cv::Mat row_i = a.row(i);
+                components.row(i).convertTo(row_i, CV_64F, singular.at<double>(i));
+            }
+            x.copyTo(a.rowRange(k, k + x.rows));
+            cv::Mat last = a.row(k + x.rows);
+            delta.convertTo(last, CV_64F, std::sqrt(correction));
+        }
+
+        mean = (mean * n + batchMean * m) / (n + m);
+        seen += x.rows;
+
+        // Until two distinct samples were seen, e.g. a first batch of one row,
+        // there is no spread: the basis stays empty and is computed by a later
+        // batch, whose mean correction row carries the earlier samples.
+        if (cv::norm(a, cv::NORM_INF) == 0)
+            return;
+
+        // right singular vectors of a from the eigen decomposition of a * a^T
+        cv::Mat gram, evals, evecs;
+        cv::mulTransposed(a, gram, false);
+        cv::eigen(gram, evals, evecs);
+        int k = std::min(maxComponents, evals.rows);
+        const double eps = evals.at<double>(0) * 1e-12;
+        while (k > 0 && evals.at<double>(k - 1) <= eps)
+            k--;
+        if (k == 0)
+            return;
+
+        cv::gemm(evecs.rowRange(0, k), a, 1.0, cv::noArray(), 0.0, components);
+        singular.create(k, 1, CV_64F);
+        for (int i = 0; i < k; i++)
+        {
+            double s = std::sqrt(evals.at<double>(i));
+            singular.at<double>(i) = s;
+            cv::Mat row_i = components.row(i);
+            row_i *= 1.0 / s;
+        }
+    }
+
+    int64_t samples() const { return seen; }
+
+    // Variance of the data along each component, in decreasing order.
+    cv::Mat explainedVariance() const
+    {
+        if (singular.empty())
+            return cv::Mat(0, 1, CV_64F);
+        cv::Mat var;
+        cv::pow(singular, 2, var);
+        return var / (double)std::max<int64_t>(seen - 1, 1);
+    }
+
+    // Total variance of the data seen so far, over all dimensions, not only
+    // the ones kept by the basis.
+    double totalVariance() const
+    {
+        return sumSquares / (double)std::max<int64_t>(seen - 1, 1);
+    }
+
+    // The current basis as a cv::PCA of the given type, keeping the fewest
+    // components reaching the retained variance. Without spread in the data
+    // yet the eigenvectors are empty.
+    cv::PCA toPCA(double retainedVariance = 1.0, int type = CV_32F) const
+    {
+        CV_Assert(seen > 0);
+        cv::Mat var = explainedVariance();
+        double total = totalVariance(), cumulative = 0;
+        int k = 0;
+        while (k < var.rows && (k == 0 || cumulative < retainedVariance * total))
+            cumulative += var.at<double>(k++);
+
+        cv::PCA pca;
+        mean.convertTo(pca.mean, type);
+        if (k == 0)
+            return pca;
+        components.rowRange(0, k).convertTo(pca.eigenvectors, type);
+        var.rowRange(0, k).convertTo(pca.eigenvalues, type);
+        return pca;
+    }
+
+private:
+    int maxComponents;
+    int64_t seen;
+    double sumSquares;          // sum of squared deviations from the mean
+    cv::Mat mean;               // 1 x d
+    cv::Mat components;         // k x d, orthonormal rows
+    cv::Mat singular;           // k x 1
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Orientation of many contours at once. A 2D PCA is a 2x2 covariance
+// problem with a closed form solution, so no cv::PCA nor intermediate Mat is
+// built: one pass over the points gives the centroid and the covariance, and
+// the eigen decomposition is a few flops.
+enum OrientationMode
+{
+    ORIENTATION_POINTS,     // covariance of the contour points, same result as cv::PCA on them
+    ORIENTATION_MOMENTS     // covariance of the filled shape from its central moments
+};
+
+// Struct of arrays, entry i is contour i. The major axis is
+// (cos(angle), sin(angle)) and the minor axis is perpendicular to it.
+struct ContourOrientations
+{
+    std::vector<double> cx, cy;         // centroid
+    std::vector<double> angle;          // of the major axis, in radians
+    std::vector<double> major, minor;   // eigenvalues, major >= minor
+
+    size_t size() const { return angle.size(); }
+
+    void resize(size_t n)
+    {
+        cx.resize(n);
+        cy.resize(n);
+        angle.resize(n);
+        major.resize(n);
+        minor.resize(n);
+    }
+};
+
+namespace orientation {
+
+inline void store(ContourOrientations& out, size_t i, double cx, double cy, double sxx, double sxy, double syy)
+{
+    double half = 0.5 * (sxx + syy);
+    double root = std::sqrt(0.25 * (sxx - syy) * (sxx - syy) + sxy * sxy);
+    out.cx[i] = cx;
+    out.cy[i] = cy;
+    out.angle[i] = 0.5 * std::atan2(2 * sxy, sxx - syy);
+    out.major[i] = half + root;
+    out.minor[i] = half - root;
+}
+
+inline void fromPoints(const std::vector<cv::Point>& pts, ContourOrientations& out, size_t i)
+{
+    if (pts.empty())
+    {
+        store(out, i, 0, 0, 0, 0, 0);
+        return;
+    }
+    // sums relative to the first point, avoids the cancellation of large coordinates
+    const cv::Point o = pts[0];
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+    for (size_t j = 0; j < pts.size(); j++)
+    {
+        double x = pts[j].x - o.x, y = pts[j].y - o.y;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+    }
+    double n = (double)pts.size(), mx = sx / n, my = sy / n;
+    store(out, i, o.x + mx, o.y + my, sxx / n - mx * mx, sxy / n - mx * my, syy / n - my * my);
+}
+
+} // namespace orientation
+
+// Orientation of every contour, in parallel over the contours. The moments
+// mode falls back to the points for degenerate (zero area) contours.
+inline void estimateOrientations(const std::vector<std::vector<cv::Point> >& contours, ContourOrientations& out,
+                                 OrientationMode mode = ORIENTATION_POINTS)
+{
+    out.resize(contours.size());
+    cv::parallel_for_(cv::Range(0, (int)contours.size()), [&](const cv::Range& r) {
+        for (int i = r.start; i < r.end; i++)
+        {
+            if (mode == ORIENTATION_MOMENTS)
+            {
+                cv::Moments m = cv::moments(contours[i]);
+                if (m.m00 != 0)
+                {
+                    orientation::store(out, i, m.m10 / m.m00, m.m01 / m.m00,
+                                       m.mu20 / m.m00, m.mu11 / m.m00, m.mu02 / m.m00);
+                    continue;
+                }
+            }
+            orientation::fromPoints(contours[i], out, i);
+        }
+    }, std::max(1.0, contours.size() / 256.0));
+}
@@ -2,13 +2,15 @@
 #include "opencv2/imgproc.hpp"
 #include "opencv2/highgui.hpp"
 #include <iostream>
+
+#include "contour-analytics.hpp"
  
 using namespace std;
 using namespace cv;
  
 // Function declarations
 void drawAxis(Mat&, Point, Point, Scalar, const float);
-double getOrientation(const vector<Point> &, Mat&);
+void drawOrientation(Mat&, const ContourOrientations&, size_t);
  
 void drawAxis(Mat& img, Point p, Point q, Scalar colour, const float scale = 0.2)
 {
@@ -30,51 +32,29 @@ void drawAxis(Mat& img, Point p, Point q, Scalar colour, const float scale = 0.2
     line(img, p, q, colour, 1, LINE_AA);
 }
  
-double getOrientation(const vector<Point> &pts, Mat &img)
+void drawOrientation(Mat &img, const ContourOrientations &o, size_t i)
 {
-    //Construct a buffer used by the pca analysis
-    int sz = static_cast<int>(pts.size());
-    Mat data_pts = Mat(sz, 2, CV_64F);
-    for (int i = 0; i < data_pts.rows; i++)
-    {
-        data_pts.at<double>(i, 0) = pts[i].x;
-        data_pts.at<double>(i, 1) = pts[i].y;
-    }
- 
-    //Perform PCA analysis
-    PCA pca_analysis(data_pts, Mat(), PCA::DATA_AS_ROW);
- 
     //Store the center of the object
-    Point cntr = Point(static_cast<int>(pca_analysis.mean.at<double>(0, 0)),
-                      static_cast<int>(pca_analysis.mean.at<double>(0, 1)));
+    Point cntr = Point(static_cast<int>(o.cx[i]), static_cast<int>(o.cy[i]));
  
-    //Store the eigenvalues and eigenvectors
-    vector<Point2d> eigen_vecs(2);
-    vector<double> eigen_val(2);
-    for (int i = 0; i < 2; i++)
-    {
-        eigen_vecs[i] = Point2d(pca_analysis.eigenvectors.at<double>(i, 0),
-                                pca_analysis.eigenvectors.at<double>(i, 1));
- 
-        eigen_val[i] = pca_analysis.eigenvalues.at<double>(i);
-    }
+    //Eigenvectors from the angle of the major axis, the minor one is perpendicular
+    Point2d major(cos(o.angle[i]), sin(o.angle[i]));
+    Point2d minor(-major.y, major.x);
  
     // Draw the principal components
     circle(img, cntr, 3, Scalar(255, 0, 255), 2);
-    Point p1 = cntr + 0.02 * Point(static_cast<int>(eigen_vecs[0].x * eigen_val[0]), static_cast<int>(eigen_vecs[0].y * eigen_val[0]));
-    Point p2 = cntr - 0.02 * Point(static_cast<int>(eigen_vecs[1].x * eigen_val[1]), static_cast<int>(eigen_vecs[1].y * eigen_val[1]));
+    Point p1 = cntr + 0.02 * Point(static_cast<int>(major.x * o.major[i]), static_cast<int>(major.y * o.major[i]));
+    Point p2 = cntr - 0.02 * Point(static_cast<int>(minor.x * o.minor[i]), static_cast<int>(minor.y * o.minor[i]));
     drawAxis(img, cntr, p1, Scalar(0, 255, 0), 1);
     drawAxis(img, cntr, p2, Scalar(255, 255, 0), 5);
- 
-    double angle = atan2(eigen_vecs[0].y, eigen_vecs[0].x); // orientation in radians
- 
-    return angle;
 }
  
 int main(int argc, char** argv)
 {
     // Load image
-    CommandLineParser parser(argc, argv, "{@input | pca_test1.jpg | input image}");
+    CommandLineParser parser(argc, argv, "{@input | pca_test1.jpg | input image}"
+                                         "{moments |  | orientation of the filled shapes from their moments}"
+                                         "{nodraw  |  | no debug drawing, only the table and the timings}");
     parser.about( "This program demonstrates how to use OpenCV PCA to extract the orientation of an object.\n" );
     parser.printMessage();
  
@@ -89,30 +69,32 @@ int main(int argc, char** argv)
  
     imshow("src", src);
  
-    // Convert image to grayscale
-    Mat gray;
-    cvtColor(src, gray, COLOR_BGR2GRAY);
+    // Otsu threshold, contours, area filter and descriptors in one stage
+    ContourAnalyticsParams params;
+    params.orientation = parser.has("moments") ? ORIENTATION_MOMENTS : ORIENTATION_POINTS;
+    ContourAnalytics analytics(params);
  
-    // Convert image to binary
-    Mat bw;
-    threshold(gray, bw, 50, 255, THRESH_BINARY | THRESH_OTSU);
- 
-    // Find all the contours in the thresholded image
-    vector<vector<Point> > contours;
-    findContours(bw, contours, RETR_LIST, CHAIN_APPROX_NONE);
+    // Drawing only for visualisation purposes, out of the analysis itself
+    if (!parser.has("nodraw"))
+    {
+        analytics.setDebugSink([&src](const Mat&, const ContourTable& table) {
+            for (size_t i = 0; i < table.size(); i++)
+            {
+                drawContours(src, table.contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
+                drawOrientation(src, table.orientation, i);
+            }
+        });
+    }
  
-    for (size_t i = 0; i < contours.size(); i++)
+    const ContourTable& table = analytics.process(src);
+    for (size_t i = 0; i < table.size(); i++)
     {
-        // Calculate the area of each contour
-        double area = contourArea(contours[i]);
-        // Ignore contours that are too small or too large
-        if (area < 1e2 || 1e5 < area) continue;
- 
-        // Draw each contour only for visualisation purposes
-        drawContours(src, contours, static_cast<int>(i), Scalar(0, 0, 255), 2);
-        // Find the orientation of each shape
-        getOrientation(contours[i], src);
+        cout << "contour " << i << ": area " << table.area[i] << ", perimeter " << table.perimeter[i]
+             << ", angle " << table.orientation.angle[i] * 180 / CV_PI << " deg, solidity " << table.solidity[i] << endl;
     }
+    const ContourStageTimes& t = analytics.lastTimes();
+    cout << "threshold " << t.threshold << " ms, contours " << t.contours << " ms, filter " << t.filter
+         << " ms, descriptors " << t.descriptors << " ms, drawing " << t.sink << " ms" << endl;
  
     imshow("output", src);
  
@@ -123,5 +105,5 @@ int main(int argc, char** argv)
 /*
 Example usage
 
-./build/application --input /home/pc/dev/opencv/dataset/att_faces/s1/1.pgm
+./build/pca-introduction --input /home/pc/dev/opencv/dataset/att_faces/s1/1.pgm
 */
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// A PCA decomposed once and kept with all its components sorted by variance,
+// with the cumulative variance, so a model for any retained variance or any
+// number of components is a slice of it. Slices share the basis, projecting
+// with them costs only the product with the kept components.
+class PCAModel
+{
+public:
+    PCAModel() : total(0) {}
+
+    // From a PCA with all its components, or from a truncated one given the
+    // total variance of the data.
+    explicit PCAModel(const cv::PCA& pca_, double totalVariance = 0) : pca(pca_)
+    {
+        CV_Assert((size_t)pca.eigenvectors.rows == pca.eigenvalues.total());
+        cv::Mat values;
+        pca.eigenvalues.convertTo(values, CV_64F);
+        cumulative.resize(values.total());
+        double sum = 0;
+        for (size_t i = 0; i < cumulative.size(); i++)
+            cumulative[i] = sum += values.at<double>((int)i);
+        total = std::max(totalVariance, sum);
+    }
+
+    // Full decomposition of the rows of data.
+    static PCAModel fit(const cv::Mat& data)
+    {
+        return PCAModel(cv::PCA(data, cv::Mat(), cv::PCA::DATA_AS_ROW, 0));
+    }
+
+    bool empty() const { return cumulative.empty(); }
+    int components() const { return (int)cumulative.size(); }
+    double totalVariance() const { return total; }
+
+    // Fraction of the variance kept by the first k components.
+    double retainedVariance(int k) const
+    {
+        k = std::min(k, components());
+        return k > 0 && total > 0 ? cumulative[k - 1] / total : 0;
+    }
+
+    // Fewest components keeping the given fraction of the variance, at least
+    // one. Capped by the components available in a truncated model.
+    int componentsFor(double retainedVariance) const
+    {
+        CV_Assert(!empty());
+        size_t k = std::lower_bound(cumulative.begin(), cumulative.end(), retainedVariance * total) - cumulative.begin();
+        return (int)std::min(k + 1, cumulative.size());
+    }
+
+    // The first k components, without copying them.
+    cv::PCA slice(int k) const
+    {
+        CV_Assert(!empty() && k > 0);
+        k = std::min(k, components());
+        cv::PCA s;
+        s.mean = pca.mean;
+        s.eigenvectors = pca.eigenvectors.rowRange(0, k);
+        s.eigenvalues = pca.eigenvalues.rowRange(0, k);
+        return s;
+    }
+
+    cv::PCA sliceVariance(double retainedVariance) const
+    {
+        return slice(componentsFor(retainedVariance));
+    }
+
+    const cv::PCA& full() const { return pca; }
+
+private:
+    cv::PCA pca;
+    std::vector<double> cumulative;
+    double total;
+};
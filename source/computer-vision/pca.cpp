@@ -2,13 +2,23 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <filesystem>
+#include <map>
+#include <memory>
+
+#include "eigenface-recognizer.hpp"
+#include "image-dataset.hpp"
+#include "incremental-pca.hpp"
+#include "pca-model.hpp"
+#include "randomized-pca.hpp"
 
 namespace fs = std::filesystem;
 struct params
 {
-    cv::Mat data;
+    cv::Mat query;              // the image shown, as a row
+    PCAModel model;             // decomposed once, sliced by the trackbar
     int ch;
     int rows;
     cv::PCA pca;
@@ -16,22 +26,6 @@ struct params
 };
 
 
-static void readImageList(const std::vector<std::string>& paths, std::vector<cv::Mat>& images) {
-	for (const auto &path : paths) {
-		images.push_back(cv::imread(path, cv::IMREAD_GRAYSCALE));
-	}
-}
-
-static  cv::Mat formatImagesForPCA(const std::vector<cv::Mat> &data) {
-    cv::Mat dst(static_cast<int>(data.size()), data[0].rows*data[0].cols, CV_32F);
-    for(unsigned int i = 0; i < data.size(); i++) {
-        cv::Mat image_row = data[i].clone().reshape(1, 1);
-        cv::Mat row_i = dst.row(i);
-        image_row.convertTo(row_i, CV_32F);
-    }
-    return dst;
-}
-
 static cv::Mat toGrayscale(cv::InputArray _src) 
 {
 	cv::Mat src = _src.getMat();
@@ -48,14 +42,14 @@ static cv::Mat toGrayscale(cv::InputArray _src)
 static void onTrackbar(int pos, void* ptr)
 {
     std::cout << "Retained Variance = " << pos << "%   ";
-    std::cout << "re-calculating PCA..." << std::flush;
+    std::cout << "slicing PCA..." << std::flush;
  
     double var = pos / 100.0;
     struct params *p = (struct params *)ptr;
  
-    p->pca = cv::PCA(p->data, cv::Mat(), cv::PCA::DATA_AS_ROW, var);
+    p->pca = p->model.sliceVariance(var);
  
-   	cv::Mat point = p->pca.project(p->data.row(0));
+   	cv::Mat point = p->pca.project(p->query);
     cv::Mat reconstruction = p->pca.backProject(point);
     reconstruction = reconstruction.reshape(p->ch, p->rows);
     reconstruction = toGrayscale(reconstruction);
@@ -70,6 +64,12 @@ int main(int argc, char** argv) {
 	// argument parser
 	cv::CommandLineParser parser(argc, argv, 
 		"{@input||image list}"
+        "{backend|dense|dense (cv::PCA), randomized (truncated SVD) or incremental (streamed in mini-batches)}"
+        "{components|100|components kept by the randomized and incremental backends}"
+        "{power-iters|2|power iterations of the randomized backend}"
+        "{batch|256|images per mini-batch of the incremental backend}"
+        "{cache||packed dataset cache, built on the first run and memory mapped by the next ones}"
+        "{topk|5|nearest images of the first one printed by the recognition demo}"
         "{help h||show help message}");
 
 	if (parser.has("help")) {
@@ -91,41 +91,124 @@ int main(int argc, char** argv) {
 			paths.push_back(entry.path().string());
 		}
 	}
+	// sorted so the order, and a cache built from it, do not depend on the file system
+	std::sort(paths.begin(), paths.end());
 	std::cout << "There are " << paths.size() << " images in your dataset\n";
 
-	// vector to hold the images
-    std::vector<cv::Mat> images;
+	// quit if there are not enough images for this demo.
+	if(paths.size() <= 1) {
+        std::string error_message = "This demo needs at least 2 images to work.";
+        CV_Error(cv::Error::StsError, error_message);
+    }
+
+    cv::Mat data, query;
+    cv::Size imageSize;
+    PCAModel model;
+    std::unique_ptr<ImageDataset> cache;
+    std::string cachePath = parser.get<std::string>("cache");
+    std::string backend = parser.get<std::string>("backend");
+    int components = std::max(1, parser.get<int>("components"));
+    bool incremental = backend == "incremental";
+    if (backend != "dense" && backend != "randomized" && !incremental) {
+        std::cerr << "Unknown backend " << backend << "\n";
+        exit(1);
+    }
 
 	// read in the data. This can fail if not valid
 	try {
-		readImageList(paths, images);
+		int64 start = cv::getTickCount();
+		if (!cachePath.empty()) {
+			// decoded once, mapped without decoding by the next runs
+			cache.reset(new ImageDataset(paths, cachePath));
+			data = cache->data();
+			imageSize = cache->imageSize();
+			std::cout << (cache->fromCache() ? "Mapped " : "Built ") << cachePath << " in "
+			          << (cv::getTickCount() - start) * 1000. / cv::getTickFrequency() << " ms\n";
+		} else if (!incremental) {
+			data = ImageDataset::decode(paths, imageSize);
+			std::cout << "Decoded in " << (cv::getTickCount() - start) * 1000. / cv::getTickFrequency() << " ms\n";
+		}
+
+		if (incremental) {
+			// only one mini-batch of images is decoded, or paged in from the cache, at a time
+			IncrementalPCA ipca(components);
+			size_t batch = (size_t)std::max(1, parser.get<int>("batch"));
+			for (size_t first = 0; first < paths.size(); first += batch) {
+				size_t last = std::min(paths.size(), first + batch);
+				cv::Mat rows;
+				if (!data.empty()) {
+					rows = data.rowRange((int)first, (int)last);
+				} else {
+					std::vector<std::string> chunk(paths.begin() + first, paths.begin() + last);
+					rows = ImageDataset::decode(chunk, imageSize);
+				}
+				if (first == 0)
+					query = rows.row(0).clone();
+				ipca.partialFit(rows);
+				std::cout << "\rProcessed " << ipca.samples() << " / " << paths.size() << " images" << std::flush;
+			}
+			std::cout << "\n";
+			model = PCAModel(ipca.toPCA(), ipca.totalVariance());
+		}
 	} catch(const cv::Exception& e) {
 		std::cerr << "Error opening file \"" << dataset << "\". Reason: " << e.msg << "\n";
 		exit(1);		
 	}
 
-	// quit if there are not enough images for this demo.
-	if(images.size() <= 1) {
-        std::string error_message = "This demo needs at least 2 images to work.";
-        CV_Error(cv::Error::StsError, error_message);
+    if (!incremental) {
+        query = data.row(0);
+        std::cout << "Data: " << data.size() << "\n";
+
+        // perform PCA, keeping all the components so any retained variance is a slice
+        if (backend == "randomized") {
+            RandomizedPCAParams rp;
+            rp.components = components;
+            rp.powerIterations = std::max(0, parser.get<int>("power-iters"));
+            double totalVariance = 0;
+            cv::PCA basis = randomizedPCA(data, rp, &totalVariance);
+            model = PCAModel(basis, totalVariance);
+        } else {
+            model = PCAModel::fit(data);
+        }
     }
- 
-   	// reshape and stack images into a rowMatrix
-    cv::Mat data = formatImagesForPCA(images);
-    std::cout << "Data: " << data.size() << "\n";
-
-    // perform PCA
-    cv::PCA pca(data, cv::Mat(), cv::PCA::DATA_AS_ROW, 0.95);
+    // a single image, or identical ones, leaves the incremental basis empty
+    if (model.empty()) {
+        std::cerr << "No variance in the data, there is nothing to decompose\n";
+        exit(1);
+    }
+    cv::PCA pca = model.sliceVariance(0.95);
 
     // Print the eigenvalues and eigenvectors
     std::cout << "Eigenvalues shape: " << pca.eigenvalues.size() << "\n";
     std::cout << "Eigenvectors shape: " << pca.eigenvectors.size() << "\n";
 
+    // recognition: all the images in the gallery, labelled by their directory,
+    // and the nearest ones of the first image
+    if (!data.empty()) {
+        std::map<std::string, int> ids;
+        std::vector<int> labels(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+            std::string person = fs::path(paths[i]).parent_path().filename().string();
+            labels[i] = ids.emplace(person, (int)ids.size()).first->second;
+        }
+        EigenfaceRecognizer recognizer(pca);
+        recognizer.add(data, labels);
+
+        // one more match, the query itself is in the gallery
+        std::vector<std::vector<FaceMatch> > matches;
+        recognizer.match(query, std::max(1, parser.get<int>("topk")) + 1, matches);
+        std::cout << "Nearest images of " << paths[0] << ":\n";
+        for (const FaceMatch& m : matches[0]) {
+            if (m.index != 0)
+                std::cout << "  " << paths[m.index] << "  distance " << m.distance << "\n";
+        }
+    }
+
 
     // demostrate the effect of retainedVariance on the first image
-    cv::Mat point = pca.project(data.row(0)); // project into the eigenspace, thus the image becomes a "point"
+    cv::Mat point = pca.project(query); // project into the eigenspace, thus the image becomes a "point"
     cv::Mat reconstruction = pca.backProject(point); // re-create the image from the "point"
-    reconstruction = reconstruction.reshape(images[0].channels(), images[0].rows); // reshape from a row vector into image shape
+    reconstruction = reconstruction.reshape(1, imageSize.height); // reshape from a row vector into image shape
     reconstruction = toGrayscale(reconstruction); // re-scale for displaying purposes
     std::cout << "Reconstruction: " << reconstruction.size() << "\n";
 
@@ -135,9 +218,10 @@ int main(int argc, char** argv) {
  
     // params struct to pass to the trackbar handler
     params p;
-    p.data = data;
-    p.ch = images[0].channels();
-    p.rows = images[0].rows;
+    p.query = query;
+    p.model = model;
+    p.ch = 1;
+    p.rows = imageSize.height;
     p.pca = pca;
     p.winName = winName;
  
@@ -155,7 +239,16 @@ int main(int argc, char** argv) {
 
 /*
 example usage with att_faces dataset:
- ./build/application --input /home/pc/dev/opencv/dataset/att_faces
+ ./build/pca --input /home/pc/dev/opencv/dataset/att_faces
+
+streaming a large dataset, 128 images at a time, keeping 150 components:
+ ./build/pca /data/faces --backend=incremental --batch=128 --components=150
+
+100 components with the randomized backend:
+ ./build/pca /home/pc/dev/opencv/dataset/att_faces --backend=randomized --components=100
+
+decoding the dataset once, the next runs map the cache:
+ ./build/pca /home/pc/dev/opencv/dataset/att_faces --cache=att_faces.imgm
 
 get dataset from:
 http://www.cl.cam.ac.uk/research/dtg/attarchive/facedatabase.html
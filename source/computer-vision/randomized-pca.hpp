@@ -0,0 +1,146 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Truncated PCA with the randomized range finder of Halko, Martinsson and
+// Tropp ("Finding structure with randomness", 2011). The data is multiplied
+// by a few random vectors, refined with power iterations, and only the small
+// projection of the data on the resulting basis is decomposed. The cost is
+// O(n d l) for l = components + oversample, instead of the O(n^2 d + n^3) of
+// cv::PCA on n samples of dimension d.
+struct RandomizedPCAParams
+{
+    int components = 100;
+    int oversample = 10;        // extra random vectors, improves the accuracy of the last components
+    int powerIterations = 2;    // more for slowly decaying spectra
+    uint64 seed = 0x12345678;
+};
+
+namespace randomized_pca {
+
+// c = op(a) * b with the rows of c split over threads, op(a) = a^T when
+// transposeA is set. cv::gemm itself runs on a single thread.
+inline void parallelGemm(const cv::Mat& a, const cv::Mat& b, cv::Mat& c, bool transposeA = false)
+{
+    int rows = transposeA ? a.cols : a.rows;
+    c.create(rows, b.cols, a.type());
+    int block = std::max(16, rows / (cv::getNumThreads() * 4));
+    cv::parallel_for_(cv::Range(0, (rows + block - 1) / block), [&](const cv::Range& r) {
+        for (int i = r.start; i < r.end; i++)
+        {
+            int r0 = i * block, r1 = std::min(rows, r0 + block);
+            cv::Mat ci = c.rowRange(r0, r1);
+            if (transposeA)
+                cv::gemm(a.colRange(r0, r1), b, 1.0, cv::noArray(), 0.0, ci, cv::GEMM_1_T);
+            else
+                cv::gemm(a.rowRange(r0, r1), b, 1.0, cv::noArray(), 0.0, ci);
+        }
+    });
+}
+
+// (x - 1 mean) * b without building the centered data.
+inline void centeredProduct(const cv::Mat& x, const cv::Mat& mean, const cv::Mat& b, cv::Mat& c)
+{
+    parallelGemm(x, b, c);
+    cv::Mat shift = mean * b;
+    for (int i = 0; i < c.rows; i++)
+    {
+        cv::Mat row_i = c.row(i);
+        row_i -= shift;
+    }
+}
+
+// (x - 1 mean)^T * b = x^T b - mean^T (1^T b)
+inline void centeredProductT(const cv::Mat& x, const cv::Mat& mean, const cv::Mat& b, cv::Mat& c)
+{
+    parallelGemm(x, b, c, true);
+    cv::Mat sums;
+    cv::reduce(b, sums, 0, cv::REDUCE_SUM);
+    c -= mean.t() * sums;
+}
+
+// Orthonormalize the columns of m in place, modified Gram-Schmidt applied
+// twice for stability in single precision.
+inline void orthonormalize(cv::Mat& m)
+{
+    cv::Mat t = m.t();
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < t.rows; i++)
+        {
+            cv::Mat ti = t.row(i);
+            for (int j = 0; j < i; j++)
+            {
+                cv::Mat tj = t.row(j);
+                ti -= tj * tj.dot(ti);
+            }
+            double len = cv::norm(ti);
+            if (len > 0)
+                ti *= 1.0 / len;
+        }
+    }
+    cv::transpose(t, m);
+}
+
+} // namespace randomized_pca
+
+// PCA of the rows of data (CV_32F or CV_64F), with the given number of
+// components. totalVariance receives the variance of the data over all
+// dimensions, to relate the eigenvalues to a retained variance.
+inline cv::PCA randomizedPCA(const cv::Mat& data, const RandomizedPCAParams& params = RandomizedPCAParams(),
+                             double* totalVariance = NULL)
+{
+    using namespace randomized_pca;
+    CV_Assert(data.channels() == 1 && (data.depth() == CV_32F || data.depth() == CV_64F));
+    CV_Assert(data.rows > 1 && params.components > 0);
+
+    const int n = data.rows, d = data.cols;
+    const int l = std::min(params.components + std::max(0, params.oversample), std::min(n, d));
+
+    cv::PCA pca;
+    cv::reduce(data, pca.mean, 0, cv::REDUCE_AVG, data.type());
+    if (totalVariance)
+        *totalVariance = (cv::norm(data, cv::NORM_L2SQR) - n * cv::norm(pca.mean, cv::NORM_L2SQR)) / (n - 1);
+
+    // range of the centered data: q = orth((x - mean) * omega), refined by
+    // power iterations alternating sides
+    cv::Mat omega(d, l, data.type()), q, z;
+    cv::RNG rng(params.seed);
+    rng.fill(omega, cv::RNG::NORMAL, 0, 1);
+    centeredProduct(data, pca.mean, omega, q);
+    orthonormalize(q);
+    for (int it = 0; it < params.powerIterations; it++)
+    {
+        centeredProductT(data, pca.mean, q, z);
+        orthonormalize(z);
+        centeredProduct(data, pca.mean, z, q);
+        orthonormalize(q);
+    }
+
+    // b = q^T (x - mean) is l x d, its right singular vectors are the
+    // components. They come from the small l x l Gram matrix, in double.
+    cv::Mat bt, gram, evals, evecs, components;
+    centeredProductT(data, pca.mean, q, z);
+    z.convertTo(bt, CV_64F);
+    cv::mulTransposed(bt, gram, true);
+    cv::eigen(gram, evals, evecs);
+    int k = std::min(params.components, l);
+    while (k > 1 && evals.at<double>(k - 1) <= evals.at<double>(0) * 1e-12)
+        k--;
+
+    cv::gemm(evecs.rowRange(0, k), bt, 1.0, cv::noArray(), 0.0, components, cv::GEMM_2_T);
+    cv::Mat eigenvalues(k, 1, CV_64F);
+    for (int i = 0; i < k; i++)
+    {
+        double s2 = std::max(evals.at<double>(i), 0.0);
+        eigenvalues.at<double>(i) = s2 / (n - 1);
+        cv::Mat row_i = components.row(i);
+        row_i *= s2 > 0 ? 1.0 / std::sqrt(s2) : 0.0;
+    }
+    components.convertTo(pca.eigenvectors, data.type());
+    eigenvalues.convertTo(pca.eigenvalues, data.type());
+    return pca;
+}
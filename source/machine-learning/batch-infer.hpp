@@ -0,0 +1,93 @@
+#pragma once
+
+#include <opencv2/dnn.hpp>
+
+#include <vector>
+
+#include "preprocess.hpp"
+#include "trace.hpp"
+
+// Runs a network on several images (or several crops of one image) in a
+// single forward pass. All items are resized to the same input size and
+// packed into one NCHW blob by a PreprocessKernel. The blob is kept between
+// calls, so it is only reallocated when the batch size changes.
+class BatchedForward
+{
+public:
+    BatchedForward(cv::dnn::Net& net_, double scale, cv::Size size,
+                   const cv::Scalar& mean = cv::Scalar(), bool swapRB = false, bool crop = false)
+        : net(net_), preprocess(makeSpec(scale, size, mean, swapRB, crop)) {}
+
+    BatchedForward(cv::dnn::Net& net_, const PreprocessSpec& spec) : net(net_), preprocess(spec) {}
+
+    // Returns one output per image, shaped like the output of a batch of one
+    // (1 x C x H x W). The outputs point into the network output, they are
+    // only valid until the next call.
+    const std::vector<cv::Mat>& forward(const std::vector<cv::Mat>& images)
+    {
+        items.clear();
+        if (images.empty())
+            return items;
+
+        preprocess.run(images, blob);
+        {
+            TRACE_SCOPE("net.forward");
+            net.setInput(blob);
+            out = net.forward();
+        }
+        CV_Assert(out.dims >= 2 && out.size[0] == (int)images.size());
+
+        std::vector<int> shape(out.size.p, out.size.p + out.dims);
+        shape[0] = 1;
+        for (int i = 0; i < (int)images.size(); i++)
+            items.push_back(cv::Mat(shape, out.type(), out.ptr(i)));
+        return items;
+    }
+
+    // Same as above for regions of a single image, e.g. hand crops around
+    // the wrists of a body pose. The crops are not copied. Regions entirely
+    // outside the image are not run, their output is an empty Mat, so output
+    // i is still the one of rois[i].
+    const std::vector<cv::Mat>& forward(const cv::Mat& image, const std::vector<cv::Rect>& rois)
+    {
+        crops.clear();
+        slots.clear();
+        for (size_t i = 0; i < rois.size(); i++)
+        {
+            cv::Rect r = rois[i] & cv::Rect(0, 0, image.cols, image.rows);
+            if (r.empty())
+                continue;
+            crops.push_back(image(r));
+            slots.push_back((int)i);
+        }
+        forward(crops);
+        if (crops.size() == rois.size())
+            return items;
+
+        std::vector<cv::Mat> placed(rois.size());
+        for (size_t j = 0; j < slots.size(); j++)
+            placed[slots[j]] = items[j];
+        items.swap(placed);
+        return items;
+    }
+
+private:
+    // the preprocessing of cv::dnn::blobFromImages
+    static PreprocessSpec makeSpec(double scale, cv::Size size, const cv::Scalar& mean, bool swapRB, bool crop)
+    {
+        PreprocessSpec spec;
+        spec.size = size;
+        spec.resize = crop ? RESIZE_CROP : RESIZE_STRETCH;
+        spec.mean = mean;
+        spec.scale = scale;
+        spec.swapRB = swapRB;
+        return spec;
+    }
+
+    cv::dnn::Net& net;
+    PreprocessKernel preprocess;
+
+    cv::Mat blob, out;
+    std::vector<cv::Mat> crops, items;
+    std::vector<int> slots;         // roi of each crop
+};
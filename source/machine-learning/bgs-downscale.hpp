@@ -0,0 +1,98 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/background_segm.hpp>
+
+// Runs a background subtractor on a downsampled (and optionally cropped)
+// copy of the frame and brings the mask back to full resolution. The cost of
+// the model is per pixel, so a factor f divides it by f*f.
+//
+// Upsampling alone gives blocky borders. With refinement, the pixels within
+// one coarse pixel of a border are decided again at full resolution by
+// comparing the frame to the upsampled background image of the model.
+class ScaledBackgroundSubtractor
+{
+public:
+    struct Params
+    {
+        int factor = 2;             // 1 runs the model at full resolution
+        cv::Rect roi;               // empty: whole frame, the mask is 0 outside
+        bool refine = true;         // edge-aware refinement of the borders
+        double refineThreshold = 25;// min difference to the background for foreground
+        int backgroundEvery = 10;   // refresh of the background image, in frames
+    };
+
+    ScaledBackgroundSubtractor(const cv::Ptr<cv::BackgroundSubtractor>& model_, const Params& params_ = Params())
+        : model(model_), params(params_), frames(0)
+    {
+        CV_Assert(!model.empty() && params.factor >= 1);
+    }
+
+    void apply(const cv::Mat& frame, cv::Mat& mask, double learningRate = -1)
+    {
+        cv::Rect region(0, 0, frame.cols, frame.rows);
+        if (!params.roi.empty())
+            region &= params.roi;
+        cv::Mat src = frame(region);
+
+        mask.create(frame.size(), CV_8UC1);
+        if (region.size() != frame.size())
+            mask.setTo(cv::Scalar::all(0));
+        cv::Mat dst = mask(region);
+
+        if (params.factor == 1)
+        {
+            model->apply(src, small, learningRate);
+            small.copyTo(dst);
+            return;
+        }
+
+        double fx = 1.0 / params.factor;
+        cv::resize(src, small, cv::Size(), fx, fx, cv::INTER_AREA);
+        model->apply(small, smallMask, learningRate);
+        cv::resize(smallMask, dst, region.size(), 0, 0, cv::INTER_NEAREST);
+
+        if (params.refine)
+            refine(src, dst);
+        frames++;
+    }
+
+    cv::Ptr<cv::BackgroundSubtractor> getModel() const { return model; }
+
+private:
+    void refine(const cv::Mat& src, cv::Mat& dst)
+    {
+        if (frames % std::max(1, params.backgroundEvery) == 0 || background.size() != src.size())
+        {
+            model->getBackgroundImage(smallBackground);
+            if (smallBackground.empty() || smallBackground.type() != src.type())
+                return;
+            cv::resize(smallBackground, background, src.size(), 0, 0, cv::INTER_LINEAR);
+        }
+
+        // band of uncertain pixels around the coarse borders
+        cv::threshold(dst, fg, 200, 255, cv::THRESH_BINARY);
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(params.factor + 1, params.factor + 1));
+        cv::dilate(fg, band, kernel);
+        cv::erode(fg, inner, kernel);
+        cv::subtract(band, inner, band);
+
+        // full resolution decision inside the band
+        cv::absdiff(src, background, diff);
+        if (diff.channels() == 3)
+            cv::cvtColor(diff, diffGray, cv::COLOR_BGR2GRAY);
+        else
+            diffGray = diff;
+        cv::compare(diffGray, params.refineThreshold, decided, cv::CMP_GT);
+        cv::bitwise_and(decided, band, decided);
+        dst.setTo(cv::Scalar::all(0), band);
+        dst.setTo(cv::Scalar::all(255), decided);
+    }
+
+    cv::Ptr<cv::BackgroundSubtractor> model;
+    Params params;
+    int64_t frames;
+    cv::Mat small, smallMask, smallBackground, background;
+    cv::Mat fg, band, inner, diff, diffGray, decided;
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/background_segm.hpp>
+
+#include "bgs-downscale.hpp"
+#include "metrics.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct ForegroundComponent
+{
+    cv::Rect box;
+    int area;
+    cv::Point2d centroid;
+};
+
+struct ForegroundResult
+{
+    int stream;
+    int64_t frameId;
+    std::vector<ForegroundComponent> components;
+};
+
+// Background subtraction for many camera streams. Every stream owns a MOG2
+// model and is assigned to one worker for its whole life (stream % workers),
+// each worker being pinned to one core, so a model and its buffers stay in
+// the cache of that core. Results are handed to the callback on the worker
+// thread.
+//
+// MOG2 itself uses cv::parallel_for_, with many streams it is usually better
+// to call cv::setNumThreads(0) and let the workers provide the parallelism.
+// The model updates and the mask clean up are timed in the bgs_service.*
+// metrics.
+class BackgroundService
+{
+public:
+    struct Params
+    {
+        int workers = 0;            // 0: one per hardware thread
+        bool pinWorkers = true;     // pin worker i to core i
+        size_t queueDepth = 4;      // frames queued per worker
+        int history = 500;
+        double varThreshold = 10;
+        bool detectShadows = true;
+        int minArea = 50;           // smaller components are dropped, in full resolution pixels
+        int downscale = 1;          // run the models on frames downsampled by this factor
+        bool refineEdges = true;    // refine the upsampled mask borders, see ScaledBackgroundSubtractor
+    };
+    typedef std::function<void(const ForegroundResult&)> Callback;
+
+    BackgroundService(int streams, const Params& params_, Callback callback_)
+        : params(params_), callback(callback_),
+          applyTime(metrics::histogram("bgs_service.apply")), refineTime(metrics::histogram("bgs_service.refine")),
+          frames(metrics::counter("bgs_service.frames")), dropped(metrics::counter("bgs_service.dropped"))
+    {
+        int n = params.workers > 0 ? params.workers : (int)std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < n; i++)
+            workers.emplace_back(new Worker());
+        for (int s = 0; s < streams; s++)
+            addStream(s);
+        for (int i = 0; i < n; i++)
+            workers[i]->thread = std::thread(&BackgroundService::run, this, i);
+    }
+
+    ~BackgroundService()
+    {
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            {
+                std::lock_guard<std::mutex> lock(workers[i]->mutex);
+                workers[i]->stop = true;
+            }
+            workers[i]->changed.notify_all();
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i]->thread.join();
+    }
+
+    int workerOf(int stream) const { return stream % (int)workers.size(); }
+    int workerCount() const { return (int)workers.size(); }
+
+    // Queue a copy of the frame for its stream. When the worker queue is full
+    // either wait for room or drop the frame and return false. The copy is
+    // made without holding the worker lock, frames being copied by other
+    // producers count in the queue depth.
+    bool submit(int stream, const cv::Mat& frame, int64_t frameId, bool wait = true)
+    {
+        Worker& w = *workers[workerOf(stream)];
+        std::unique_lock<std::mutex> lock(w.mutex);
+        CV_Assert(w.streams.count(stream));
+        if (w.queue.size() + w.copying >= params.queueDepth)
+        {
+            if (!wait)
+            {
+                dropped.add();
+                return false;
+            }
+            w.changed.wait(lock, [&] { return w.queue.size() + w.copying < params.queueDepth; });
+        }
+        Job job;
+        job.stream = stream;
+        job.frameId = frameId;
+        // recycle the buffers of processed frames
+        if (!w.spare.empty())
+        {
+            job.frame = w.spare.back();
+            w.spare.pop_back();
+        }
+        w.copying++;
+        lock.unlock();
+
+        try
+        {
+            frame.copyTo(job.frame);
+        }
+        catch (...)
+        {
+            lock.lock();
+            w.copying--;
+            lock.unlock();
+            w.changed.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        w.copying--;
+        w.queue.push_back(job);
+        lock.unlock();
+        w.changed.notify_all();
+        return true;
+    }
+
+    // Block until every queued frame has been processed.
+    void flush()
+    {
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            Worker& w = *workers[i];
+            std::unique_lock<std::mutex> lock(w.mutex);
+            w.changed.wait(lock, [&] { return w.queue.empty() && w.copying == 0 && !w.busy; });
+        }
+    }
+
+    // Time spent by each worker processing frames, in seconds. Call it after
+    // flush(), the counters are updated by the workers.
+    std::vector<double> busyTime() const
+    {
+        std::vector<double> t;
+        for (size_t i = 0; i < workers.size(); i++)
+            t.push_back(workers[i]->busyTicks / cv::getTickFrequency());
+        return t;
+    }
+
+private:
+    struct Job
+    {
+        int stream;
+        int64_t frameId;
+        cv::Mat frame;
+    };
+
+    // Per stream state, only touched by the owning worker.
+    struct Stream
+    {
+        cv::Ptr<ScaledBackgroundSubtractor> model;
+        cv::Mat mask, labels, stats, centroids;
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Job> queue;
+        std::vector<cv::Mat> spare;
+        size_t copying = 0;         // frames taken by submit(), not queued yet
+        std::map<int, Stream> streams;
+        bool stop = false;
+        bool busy = false;
+        int64_t busyTicks = 0;
+    };
+
+    void addStream(int stream)
+    {
+        ScaledBackgroundSubtractor::Params scaled;
+        scaled.factor = std::max(1, params.downscale);
+        scaled.refine = params.refineEdges;
+        Stream s;
+        s.model = cv::makePtr<ScaledBackgroundSubtractor>(
+            cv::createBackgroundSubtractorMOG2(params.history, params.varThreshold, params.detectShadows), scaled);
+        workers[workerOf(stream)]->streams[stream] = s;
+    }
+
+    void run(int index)
+    {
+        Worker& w = *workers[index];
+#ifdef __linux__
+        if (params.pinWorkers)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+#endif
+        cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+        ForegroundResult result;
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(w.mutex);
+                w.changed.wait(lock, [&] { return w.stop || !w.queue.empty(); });
+                if (w.queue.empty())
+                    return;
+                job = w.queue.front();
+                w.queue.pop_front();
+                w.busy = true;
+            }
+            w.changed.notify_all();
+
+            int64_t t = cv::getTickCount();
+            Stream& s = w.streams.find(job.stream)->second;
+            {
+                metrics::ScopedTimer timer(applyTime);
+                s.model->apply(job.frame, s.mask);
+            }
+            metrics::ScopedTimer refineTimer(refineTime);
+            // drop shadows (127) and speckles before labelling
+            cv::threshold(s.mask, s.mask, 200, 255, cv::THRESH_BINARY);
+            cv::morphologyEx(s.mask, s.mask, cv::MORPH_OPEN, kernel);
+            int n = cv::connectedComponentsWithStats(s.mask, s.labels, s.stats, s.centroids, 8, CV_32S);
+
+            result.stream = job.stream;
+            result.frameId = job.frameId;
+            result.components.clear();
+            for (int i = 1; i < n; i++)
+            {
+                const int* st = s.stats.ptr<int>(i);
+                if (st[cv::CC_STAT_AREA] < params.minArea)
+                    continue;
+                ForegroundComponent c;
+                c.box = cv::Rect(st[cv::CC_STAT_LEFT], st[cv::CC_STAT_TOP], st[cv::CC_STAT_WIDTH], st[cv::CC_STAT_HEIGHT]);
+                c.area = st[cv::CC_STAT_AREA];
+                c.centroid = cv::Point2d(s.centroids.at<double>(i, 0), s.centroids.at<double>(i, 1));
+                result.components.push_back(c);
+            }
+            refineTimer.stop();
+            frames.add();
+            if (callback)
+                callback(result);
+            t = cv::getTickCount() - t;
+
+            {
+                std::lock_guard<std::mutex> lock(w.mutex);
+                w.busyTicks += t;
+                w.busy = false;
+                w.spare.push_back(job.frame);
+            }
+            w.changed.notify_all();
+        }
+    }
+
+    Params params;
+    Callback callback;
+    metrics::Histogram& applyTime;
+    metrics::Histogram& refineTime;
+    metrics::Counter& frames;
+    metrics::Counter& dropped;
+    std::vector<std::unique_ptr<Worker> > workers;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+// Turn the per-class scores of a segmentation network (1 x C x H x W) into a
+// color image, one color per arg-max class. Colors are generated on first
+// use when the list is empty. The first score channel is overwritten.
+inline void colorizeSegmentation(const cv::Mat &score, cv::Mat &segm, std::vector<cv::Vec3b> &colors)
+{
+    const int rows = score.size[2];
+    const int cols = score.size[3];
+    const int chns = score.size[1];
+
+    if (colors.empty())
+    {
+        // Generate colors.
+        colors.push_back(cv::Vec3b());
+        for (int i = 1; i < chns; ++i)
+        {
+            cv::Vec3b color;
+            for (int j = 0; j < 3; ++j)
+                color[j] = (colors[i - 1][j] + rand() % 256) / 2;
+            colors.push_back(color);
+        }
+    }
+    else if (chns != (int)colors.size())
+    {
+        CV_Error(cv::Error::StsError, cv::format("Number of output classes does not match "
+                                                 "number of colors (%d != %zu)", chns, colors.size()));
+    }
+
+    cv::Mat maxCl = cv::Mat::zeros(rows, cols, CV_8UC1);
+    cv::Mat maxVal(rows, cols, CV_32FC1, score.data);
+    for (int ch = 1; ch < chns; ch++)
+    {
+        for (int row = 0; row < rows; row++)
+        {
+            const float *ptrScore = score.ptr<float>(0, ch, row);
+            uint8_t *ptrMaxCl = maxCl.ptr<uint8_t>(row);
+            float *ptrMaxVal = maxVal.ptr<float>(row);
+            for (int col = 0; col < cols; col++)
+            {
+                if (ptrScore[col] > ptrMaxVal[col])
+                {
+                    ptrMaxVal[col] = ptrScore[col];
+                    ptrMaxCl[col] = (uchar)ch;
+                }
+            }
+        }
+    }
+
+    segm.create(rows, cols, CV_8UC3);
+    for (int row = 0; row < rows; row++)
+    {
+        const uchar *ptrMaxCl = maxCl.ptr<uchar>(row);
+        cv::Vec3b *ptrSegm = segm.ptr<cv::Vec3b>(row);
+        for (int col = 0; col < cols; col++)
+        {
+            ptrSegm[col] = colors[ptrMaxCl[col]];
+        }
+    }
+}
@@ -1,7 +1,169 @@
+#pragma once
+
 #include <opencv2/core/utils/filesystem.hpp>
+#include <opencv2/dnn.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "preprocess.hpp"
 
 using namespace cv;
 
+// Files and preprocessing of one model of the zoo file, typed. values keeps
+// every field of the model formatted as a command line default, the names of
+// the others (maps, sequences of strings) are in unsupported.
+struct ModelSpec
+{
+    std::string name, model, config;
+    Scalar mean;
+    double scale = 1.0;
+    Size size = Size(-1, -1);
+    bool rgb = false;
+    std::map<std::string, std::string> values;
+    std::set<std::string> unsupported;     // fields that can not be formatted
+
+    // Preprocessing of the model, to compile once into a PreprocessKernel.
+    PreprocessSpec preprocess() const
+    {
+        PreprocessSpec spec;
+        spec.size = size;
+        spec.mean = mean;
+        spec.scale = scale;
+        spec.swapRB = rgb;
+        return spec;
+    }
+
+    // Blob of one or several images with the preprocessing of the model. Loops
+    // should keep their own kernel, these compile one per call.
+    void blobFromImage(const Mat& image, Mat& blob) const
+    {
+        PreprocessKernel(preprocess()).run(image, blob);
+    }
+
+    void blobFromImages(const std::vector<Mat>& images, Mat& blob) const
+    {
+        PreprocessKernel(preprocess()).run(images, blob);
+    }
+};
+
+// Registry of the models of a zoo file. Each file is parsed once per process
+// and shared: get() only looks the path up after the first call.
+class ModelZoo
+{
+public:
+    static std::shared_ptr<const ModelZoo> get(const std::string& zooFile)
+    {
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const ModelZoo> > cache;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const ModelZoo>& zoo = cache[zooFile];
+        if (!zoo)
+            zoo = std::make_shared<const ModelZoo>(zooFile);
+        return zoo;
+    }
+
+    // Prefer get(), a missing or unreadable file gives an empty zoo.
+    explicit ModelZoo(const std::string& zooFile)
+    {
+        FileStorage fs(zooFile, FileStorage::READ);
+        if (!fs.isOpened())
+            return;
+        FileNode root = fs.root();
+        for (FileNodeIterator it = root.begin(); it != root.end(); ++it)
+        {
+            FileNode node = *it;
+            if (!node.isMap())
+                continue;
+            ModelSpec spec;
+            spec.name = node.name();
+            for (FileNodeIterator f = node.begin(); f != node.end(); ++f)
+            {
+                std::string value;
+                if (formatValue(*f, value))
+                    spec.values[(*f).name()] = value;
+                else
+                    spec.unsupported.insert((*f).name());
+            }
+            readTyped(node, spec);
+            specs[spec.name] = spec;
+        }
+    }
+
+    // NULL when the model is not in the zoo.
+    const ModelSpec* find(const std::string& name) const
+    {
+        std::map<std::string, ModelSpec>::const_iterator it = specs.find(name);
+        return it == specs.end() ? NULL : &it->second;
+    }
+
+    std::vector<std::string> names() const
+    {
+        std::vector<std::string> result;
+        for (std::map<std::string, ModelSpec>::const_iterator it = specs.begin(); it != specs.end(); ++it)
+            result.push_back(it->first);
+        return result;
+    }
+
+private:
+    // False for fields that can not be a command line default (maps, sequences
+    // of strings). They only fail when used as one, see genArgument.
+    static bool formatValue(const FileNode& value, std::string& result)
+    {
+        if (value.isReal())
+            result = format("%f", (float)value);
+        else if (value.isString())
+            result = (std::string)value;
+        else if (value.isInt())
+            result = format("%d", (int)value);
+        else if (value.isSeq())
+        {
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                FileNode v = value[(int)i];
+                if (v.isInt())
+                    result += format("%d ", (int)v);
+                else if (v.isReal())
+                    result += format("%f ", (float)v);
+                else
+                    return false;
+            }
+        }
+        else
+            return false;
+        return true;
+    }
+
+    static void readTyped(const FileNode& node, ModelSpec& spec)
+    {
+        if (!node["model"].empty())
+            spec.model = (std::string)node["model"];
+        if (!node["config"].empty())
+            spec.config = (std::string)node["config"];
+        FileNode mean = node["mean"];
+        if (mean.isSeq())
+            for (int i = 0; i < (int)mean.size() && i < 4; i++)
+                spec.mean[i] = (double)mean[i];
+        else if (!mean.empty())
+            spec.mean = Scalar::all((double)mean);
+        if (!node["scale"].empty())
+            spec.scale = (double)node["scale"];
+        if (!node["width"].empty())
+            spec.size.width = (int)node["width"];
+        if (!node["height"].empty())
+            spec.size.height = (int)node["height"];
+        FileNode rgb = node["rgb"];
+        if (rgb.isString())
+            spec.rgb = (std::string)rgb == "true";
+        else if (rgb.isInt())
+            spec.rgb = (int)rgb != 0;
+    }
+
+    std::map<std::string, ModelSpec> specs;
+};
+
 std::string genArgument(const std::string& argName, const std::string& help,
                         const std::string& modelName, const std::string& zooFile,
                         char key = ' ', std::string defaultVal = "");
@@ -10,44 +172,23 @@ std::string genPreprocArguments(const std::string& modelName, const std::string&
 
 std::string findFile(const std::string& filename);
 
+ModelSpec parsePreprocArguments(const CommandLineParser& parser, const std::string& modelName);
+
 std::string genArgument(const std::string& argName, const std::string& help,
                         const std::string& modelName, const std::string& zooFile,
                         char key, std::string defaultVal)
 {
     if (!modelName.empty())
     {
-        FileStorage fs(zooFile, FileStorage::READ);
-        if (fs.isOpened())
+        const ModelSpec* spec = ModelZoo::get(zooFile)->find(modelName);
+        if (spec)
         {
-            FileNode node = fs[modelName];
-            if (!node.empty())
-            {
-                FileNode value = node[argName];
-                if (!value.empty())
-                {
-                    if (value.isReal())
-                        defaultVal = format("%f", (float)value);
-                    else if (value.isString())
-                        defaultVal = (std::string)value;
-                    else if (value.isInt())
-                        defaultVal = format("%d", (int)value);
-                    else if (value.isSeq())
-                    {
-                        for (size_t i = 0; i < value.size(); ++i)
-                        {
-                            FileNode v = value[(int)i];
-                            if (v.isInt())
-                                defaultVal += format("%d ", (int)v);
-                            else if (v.isReal())
-                                defaultVal += format("%f ", (float)v);
-                            else
-                              CV_Error(Error::StsNotImplemented, "Unexpected value format");
-                        }
-                    }
-                    else
-                        CV_Error(Error::StsNotImplemented, "Unexpected field format");
-                }
-            }
+            if (spec->unsupported.count(argName))
+                CV_Error(Error::StsNotImplemented, "Unexpected format of the field " + argName +
+                         " of the model " + modelName + " in " + zooFile);
+            std::map<std::string, std::string>::const_iterator value = spec->values.find(argName);
+            if (value != spec->values.end())
+                defaultVal = value->second;
         }
     }
     return "{ " + argName + " " + key + " | " + defaultVal + " | " + help + " }";
@@ -93,3 +234,18 @@ std::string genPreprocArguments(const std::string& modelName, const std::string&
            genArgument("rgb", "Indicate that model works with RGB input images instead BGR ones.",
                        modelName, zooFile);
 }
+
+// Typed preprocessing of the arguments made by genPreprocArguments: the zoo
+// defaults with the command line overrides applied.
+ModelSpec parsePreprocArguments(const CommandLineParser& parser, const std::string& modelName)
+{
+    ModelSpec spec;
+    spec.name = modelName;
+    spec.model = parser.get<String>("model");
+    spec.config = parser.get<String>("config");
+    spec.mean = parser.get<Scalar>("mean");
+    spec.scale = parser.get<double>("scale");
+    spec.size = Size(parser.get<int>("width"), parser.get<int>("height"));
+    spec.rgb = parser.get<bool>("rgb");
+    return spec;
+}
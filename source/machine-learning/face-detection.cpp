@@ -3,6 +3,10 @@
 #include "opencv2/imgproc.hpp"
 #include "opencv2/videoio.hpp"
 #include <iostream>
+
+#include "frame-source.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
  
 using namespace std;
 using namespace cv;
@@ -21,7 +25,7 @@ static void help(const char** argv)
             "\t[filename|camera_index]\n\n"
 
         <<   "Example usage:\n"
-             "   ./build/application\n"
+             "   ./build/face-detection\n"
             "\t--cascade=/path/to/your/haarcascade_frontalface_alt.xml\n"
             "\t--nested-cascade=/path/to/your/haarcascade_eye_tree_eyeglasses.xml\n"
             "\t--scale=1.3\n\n"
@@ -40,7 +44,7 @@ string nestedCascadeName;
 int main(int argc, const char** argv)
 {
     cv::VideoCapture capture;
-    cv::Mat frame, image;
+    cv::Mat image;
     cv::CascadeClassifier cascade, nestedCascade;
     std::string inputName;
     bool tryflip;
@@ -51,7 +55,9 @@ int main(int argc, const char** argv)
         "{help h||}"
         "{cascade||}"
         "{nested-cascade||}"
-        "{scale||}{try-flip||}{@filename||}");
+        "{scale||}{try-flip||}{@filename||}"
+        METRICS_KEYS
+        TRACE_KEYS);
 
     if (parser.has("help")) {
         help(argv);
@@ -79,6 +85,10 @@ int main(int argc, const char** argv)
     if (!nestedCascade.load(cv::samples::findFileOrKeep(nestedCascadeName))) {
         std::cerr << "WARNING: Could not load classifier cascade for nested objects\n";
     }
+
+    // periodic dump of the timings and trace of the stages, when asked for
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
     
     // choose to turn on camera
     if(inputName.empty() || (isdigit(inputName[0]) && inputName.size() == 1) ) {
@@ -103,11 +113,14 @@ int main(int argc, const char** argv)
  
     if(capture.isOpened()) {
         std::cout << "Video capturing has been started ...\n";
-        for(;;) {
-            capture >> frame;
-            if(frame.empty()) break;
-            cv::Mat frame1 = frame.clone();
-            detectAndDraw(frame1, scale, tryflip, cascade, nestedCascade);
+        // decode on a separate thread, frames are owned by the ring so we can draw on them
+        bool live = inputName.empty() || (isdigit(inputName[0]) && inputName.size() == 1);
+        FrameSource source([&capture](cv::Mat& m) { return capture.read(m); }, 4,
+                           live ? FrameSource::DropOldest : FrameSource::Block);
+        FrameSource::Frame frame;
+        while(source.read(frame)) {
+            trace::FrameScope traced(frame.index);
+            detectAndDraw(frame.image, scale, tryflip, cascade, nestedCascade);
             char c = (char)waitKey(10);
             if(c == 27 || c == 'q' || c == 'Q') break;
         }
@@ -155,7 +168,9 @@ void detectAndDraw(Mat& img, double scale, bool tryflip,
                    CascadeClassifier& cascade,
                    CascadeClassifier& nestedCascade)
 {
-    double t = 0;
+    static metrics::Histogram& detectTime = metrics::histogram("face_detection.detect");
+    static metrics::Counter& frames = metrics::counter("face_detection.frames");
+    static metrics::Counter& found = metrics::counter("face_detection.faces");
     std::vector<cv::Rect> faces, faces2;
     const static Scalar colors[] =
     {
@@ -172,12 +187,17 @@ void detectAndDraw(Mat& img, double scale, bool tryflip,
     // preprocessing
     double fx = 1 / scale;
     cv::Mat gray, smallImg;
-    cv::cvtColor(img, gray, COLOR_BGR2GRAY);
-    cv::resize(gray, smallImg, Size(), fx, fx, INTER_LINEAR_EXACT);
-    equalizeHist(smallImg, smallImg);
+    {
+        METRICS_SCOPE("face_detection.preprocess");
+        TRACE_SCOPE("preprocess");
+        cv::cvtColor(img, gray, COLOR_BGR2GRAY);
+        cv::resize(gray, smallImg, Size(), fx, fx, INTER_LINEAR_EXACT);
+        equalizeHist(smallImg, smallImg);
+    }
  
     // Cascaded prediction
-    t = (double)getTickCount();
+    metrics::ScopedTimer timer(detectTime);
+    trace::Span span("detect");
     cascade.detectMultiScale (
         smallImg, faces, 1.1, 2, 0
         |CASCADE_FIND_BIGGEST_OBJECT
@@ -203,8 +223,10 @@ void detectAndDraw(Mat& img, double scale, bool tryflip,
     }
 
     // display the prediction time
-    t = (double)getTickCount() - t;
-    std::cout << "detection time = " <<  t*1000/getTickFrequency() << "ms\n";
+    span.end();
+    std::cout << "detection time = " << timer.stop() << "ms\n";
+    frames.add();
+    found.add(faces.size());
 
 
     // display the bounding box
@@ -225,6 +247,8 @@ void detectAndDraw(Mat& img, double scale, bool tryflip,
 
         // Nested Cascaded prediction
         if(nestedCascade.empty())continue;
+        METRICS_SCOPE("face_detection.nested");
+        TRACE_SCOPE("nested");
         smallImgROI = smallImg( r );
         nestedCascade.detectMultiScale ( 
             smallImgROI, nestedObjects, 1.1, 2, 0
@@ -251,7 +275,7 @@ void detectAndDraw(Mat& img, double scale, bool tryflip,
 
 /*
 Example usage:
-    ./build/application \
+    ./build/face-detection \
         --cascade=/home/pc/libs/opencv-4.10.0/data/haarcascades/haarcascade_frontalface_alt.xml \
         --nested-cascade=/home/pc/libs/opencv-4.10.0/data/haarcascades/haarcascade_eye_tree_eyeglasses.xml \
         --scale=1.3
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame-source.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+// Output of one analyser on one frame, analysers fill the fields they need.
+struct AnalysisResult
+{
+    std::vector<cv::Rect> boxes;
+    std::vector<cv::Point2f> points;
+    cv::Mat mask;
+    double ms = 0;                  // time spent in the analyser
+};
+
+// Results of all the analysers on one frame, results[i] being the output of
+// the i-th analyser added to the graph.
+struct FrameRecord
+{
+    FrameSource::Frame frame;
+    std::vector<AnalysisResult> results;
+    double latency = 0;             // from submit to join, in milliseconds
+};
+
+// Fans one decoded frame out to several analysers running concurrently on a
+// pool of worker threads.
+//
+// The graph has two kinds of nodes. Stages are shared preprocessing, e.g. one
+// grayscale conversion used by a cascade and a HOG detector, computed once
+// per frame from the frame or another stage. Analysers read one or several
+// stages and fill an AnalysisResult. A node runs as soon as its inputs of the
+// frame are ready, and never on two frames at once, so it may keep state
+// such as a network or a classifier. Up to maxInFlight frames are in the
+// graph, a slow analyser on frame n overlaps with the others on frame n+1.
+//
+// When all the analysers of a frame are done the join callback gets its
+// record, on a worker thread and in submission order. The frame handle is
+// released after the callback returns, so the callback may draw on it.
+//
+// Node times go to the frame_graph.<name> histograms and the submit to join
+// latency to frame_graph.latency. With a trace::Session the nodes are traced
+// as spans named after them, with the frame index.
+class FrameGraph
+{
+public:
+    enum { FRAME = 0 };             // stage of the decoded frame itself
+
+    typedef std::function<void(const cv::Mat& input, cv::Mat& output)> Stage;
+    typedef std::function<void(const std::vector<cv::Mat>& inputs, AnalysisResult& result)> Analyser;
+    typedef std::function<void(const FrameRecord& record)> Join;
+
+    struct Params
+    {
+        int workers = 0;            // 0: one per hardware thread
+        size_t maxInFlight = 4;     // frames processed at the same time
+    };
+
+    FrameGraph() : FrameGraph(Params()) {}
+
+    explicit FrameGraph(const Params& params_)
+        : params(params_), stages(1), analysers(0), latencyTime(metrics::histogram("frame_graph.latency")),
+          started(false), stop(false),
+          inFlight(0), nextSeq(0), nextJoin(0)
+    {
+        params.maxInFlight = std::max<size_t>(params.maxInFlight, 1);
+        int n = params.workers > 0 ? params.workers : (int)std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < n; i++)
+            workers.push_back(std::thread(&FrameGraph::run, this));
+    }
+
+    ~FrameGraph()
+    {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Shared preprocessing of another stage. Returns the id of its output.
+    int addStage(const std::string& name, int input, const Stage& stage)
+    {
+        CV_Assert(!started && 0 <= input && input < stages);
+        std::unique_ptr<Node> node(new Node());
+        node->name = name;
+        node->inputs.push_back(input);
+        node->output = stages++;
+        node->stage = stage;
+        return addNode(std::move(node));
+    }
+
+    // Analyser of one or several stages. Returns the index of its result.
+    int addAnalyser(const std::string& name, const std::vector<int>& inputs, const Analyser& analyser)
+    {
+        CV_Assert(!started && !inputs.empty());
+        for (size_t i = 0; i < inputs.size(); i++)
+            CV_Assert(0 <= inputs[i] && inputs[i] < stages);
+        std::unique_ptr<Node> node(new Node());
+        node->name = name;
+        node->inputs = inputs;
+        node->result = analysers++;
+        node->analyser = analyser;
+        names.push_back(name);
+        addNode(std::move(node));
+        return analysers - 1;
+    }
+
+    void setJoin(const Join& join_)
+    {
+        CV_Assert(!started);
+        join = join_;
+    }
+
+    int analyserCount() const { return analysers; }
+    const std::string& analyserName(int i) const { return names[i]; }
+
+    // Fan a frame out to the analysers, waiting while maxInFlight frames are
+    // in the graph. The frame is not copied, its handle is held until the join.
+    void submit(const FrameSource::Frame& frame)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started = true;
+            changed.wait(lock, [&] { return inFlight < params.maxInFlight; });
+            inFlight++;
+            // recycle the stage buffers of joined frames
+            if (!spare.empty())
+            {
+                job = spare.back();
+                spare.pop_back();
+            }
+            else
+                job = std::make_shared<Job>();
+            job->seq = nextSeq++;
+        }
+
+        job->start = metrics::ticks();
+        job->record.frame = frame;
+        job->record.results.assign(analysers, AnalysisResult());
+        job->stages.resize(stages);
+        job->stages[FRAME] = frame.image;
+        job->pending.resize(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++)
+            job->pending[i] = (int)nodes[i]->inputs.size();
+        job->remaining = (int)nodes.size();
+
+        if (nodes.empty())
+            finish(job);
+        else
+            stageReady(job, FRAME);
+    }
+
+    // Block until every submitted frame has been joined.
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return inFlight == 0; });
+    }
+
+private:
+    struct Job
+    {
+        int64_t seq = 0;
+        uint64_t start = 0;
+        std::vector<cv::Mat> stages;    // stage outputs, FRAME is the frame
+        std::vector<int> pending;       // inputs not ready yet, per node
+        int remaining = 0;              // nodes not done yet
+        std::mutex mutex;
+        FrameRecord record;
+    };
+
+    struct Node
+    {
+        std::string name;
+        std::vector<int> inputs;
+        int output = -1;                // stage computed, -1 for an analyser
+        int result = -1;                // result filled, -1 for a stage
+        Stage stage;
+        Analyser analyser;
+        metrics::Histogram* time = NULL;
+        const char* traceName = NULL;
+
+        // frames ready for this node while it runs on another one
+        std::mutex mutex;
+        bool busy = false;
+        std::deque<std::shared_ptr<Job> > waiting;
+    };
+
+    int addNode(std::unique_ptr<Node> node)
+    {
+        int id = (int)nodes.size();
+        node->time = &metrics::histogram("frame_graph." + node->name);
+        node->traceName = trace::intern(node->name);
+        if ((int)users.size() < stages)
+            users.resize(stages);
+        for (size_t i = 0; i < node->inputs.size(); i++)
+            users[node->inputs[i]].push_back(id);
+        int output = node->output;
+        nodes.push_back(std::move(node));
+        return output;
+    }
+
+    void post(const std::function<void()>& task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(task);
+        }
+        changed.notify_all();
+    }
+
+    void schedule(int id, const std::shared_ptr<Job>& job)
+    {
+        Node& node = *nodes[id];
+        {
+            std::lock_guard<std::mutex> lock(node.mutex);
+            if (node.busy)
+            {
+                node.waiting.push_back(job);
+                return;
+            }
+            node.busy = true;
+        }
+        post([this, id, job] { runNode(id, job); });
+    }
+
+    void stageReady(const std::shared_ptr<Job>& job, int stage)
+    {
+        if (stage >= (int)users.size())
+            return;
+        for (size_t i = 0; i < users[stage].size(); i++)
+        {
+            int id = users[stage][i];
+            bool ready;
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                ready = --job->pending[id] == 0;
+            }
+            if (ready)
+                schedule(id, job);
+        }
+    }
+
+    void runNode(int id, const std::shared_ptr<Job>& job)
+    {
+        Node& node = *nodes[id];
+        trace::FrameScope frame(job->record.frame.index);
+        trace::Span span(node.traceName);
+        metrics::ScopedTimer timer(*node.time);
+        if (node.output >= 0)
+        {
+            node.stage(job->stages[node.inputs[0]], job->stages[node.output]);
+            timer.stop();
+        }
+        else
+        {
+            std::vector<cv::Mat> inputs;
+            for (size_t i = 0; i < node.inputs.size(); i++)
+                inputs.push_back(job->stages[node.inputs[i]]);
+            AnalysisResult& result = job->record.results[node.result];
+            node.analyser(inputs, result);
+            result.ms = timer.stop();
+        }
+        span.end();
+
+        // hand the node over to the next frame waiting for it
+        {
+            std::lock_guard<std::mutex> lock(node.mutex);
+            if (node.waiting.empty())
+                node.busy = false;
+            else
+            {
+                std::shared_ptr<Job> next = node.waiting.front();
+                node.waiting.pop_front();
+                post([this, id, next] { runNode(id, next); });
+            }
+        }
+
+        if (node.output >= 0)
+            stageReady(job, node.output);
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            done = --job->remaining == 0;
+        }
+        if (done)
+            finish(job);
+    }
+
+    // Join the frames in submission order.
+    void finish(const std::shared_ptr<Job>& job)
+    {
+        std::lock_guard<std::mutex> lock(joinMutex);
+        completed[job->seq] = job;
+        while (!completed.empty() && completed.begin()->first == nextJoin)
+        {
+            std::shared_ptr<Job> j = completed.begin()->second;
+            completed.erase(completed.begin());
+            nextJoin++;
+            uint64_t latency = metrics::ticks() - j->start;
+            latencyTime.recordTicks(latency);
+            j->record.latency = latency * metrics::secondsPerTick() * 1000;
+            if (join)
+            {
+                trace::Span span("join", j->record.frame.index);
+                join(j->record);
+            }
+            j->record.frame.release();
+            j->stages[FRAME].release();
+            {
+                std::lock_guard<std::mutex> poolLock(mutex);
+                spare.push_back(j);
+                inFlight--;
+            }
+            changed.notify_all();
+        }
+    }
+
+    void run()
+    {
+        trace::setThreadName("frame_graph");
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return stop || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = tasks.front();
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    Params params;
+    std::vector<std::unique_ptr<Node> > nodes;
+    std::vector<std::vector<int> > users;   // nodes reading each stage
+    std::vector<std::string> names;
+    int stages, analysers;
+    Join join;
+    metrics::Histogram& latencyTime;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::function<void()> > tasks;
+    std::vector<std::shared_ptr<Job> > spare;
+    bool started, stop;
+    size_t inFlight;
+    int64_t nextSeq;
+
+    std::mutex joinMutex;
+    std::map<int64_t, std::shared_ptr<Job> > completed;
+    int64_t nextJoin;
+};
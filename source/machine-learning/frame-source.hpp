@@ -0,0 +1,161 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+// Decodes frames on its own thread into a fixed ring of buffers, so decoding
+// overlaps with processing and no frame is allocated once the ring is warm.
+//
+// Consumers get Frame handles pointing into the ring. A buffer is reused only
+// after the last handle on it is released, so a frame can be drawn on in
+// place. Do not keep the cv::Mat of a frame past its handle, and release all
+// handles before destroying the source.
+class FrameSource
+{
+public:
+    enum Policy
+    {
+        DropOldest, // when no buffer is free, overwrite the oldest frame not yet read (live cameras)
+        Block       // wait for the consumer to release a buffer (files, benchmarks)
+    };
+
+    // Fills the Mat with the next frame, returns false at the end of the stream.
+    typedef std::function<bool(cv::Mat&)> Reader;
+
+    struct Frame
+    {
+        cv::Mat image;
+        int64_t index = -1;             // position in the stream, gaps are dropped frames
+        std::shared_ptr<void> hold;     // keeps the buffer out of the ring
+
+        bool empty() const { return image.empty(); }
+        void release() { image.release(); hold.reset(); index = -1; }
+    };
+
+    FrameSource(const Reader& reader_, size_t slots = 4, Policy policy_ = DropOldest)
+        : reader(reader_), policy(policy_), buffers(std::max<size_t>(slots, 2)), indices(buffers.size()),
+          next(0), drops(0), eof(false), stop(false)
+    {
+        for (size_t i = 0; i < buffers.size(); i++)
+            freeSlots.push_back((int)i);
+        thread = std::thread(&FrameSource::run, this);
+    }
+
+    ~FrameSource()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    FrameSource(const FrameSource&) = delete;
+    FrameSource& operator=(const FrameSource&) = delete;
+
+    // Wait for the next decoded frame. Returns false at the end of the stream.
+    bool read(Frame& frame)
+    {
+        frame.release();
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !ready.empty() || eof; });
+        if (ready.empty())
+            return false;
+        int slot = ready.front();
+        ready.pop_front();
+        frame.image = buffers[slot];
+        frame.index = indices[slot];
+        frame.hold = std::shared_ptr<void>(&buffers[slot], [this, slot](void*) { recycle(slot); });
+        return true;
+    }
+
+    // Number of frames overwritten before being read (DropOldest only).
+    int64_t dropped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return drops;
+    }
+
+private:
+    void recycle(int slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeSlots.push_back(slot);
+        }
+        changed.notify_all();
+    }
+
+    void run()
+    {
+        trace::setThreadName("decode");
+        for (;;)
+        {
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return stop || !freeSlots.empty() || (policy == DropOldest && !ready.empty());
+                });
+                if (stop)
+                    return;
+                if (!freeSlots.empty())
+                {
+                    slot = freeSlots.front();
+                    freeSlots.pop_front();
+                }
+                else
+                {
+                    slot = ready.front();
+                    ready.pop_front();
+                    drops++;
+                }
+            }
+
+            // decode outside of the lock, the buffer is reused when the size matches
+            trace::Span span("decode");
+            bool ok = reader(buffers[slot]) && !buffers[slot].empty();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!ok)
+                {
+                    freeSlots.push_back(slot);
+                    eof = true;
+                }
+                else
+                {
+                    span.setFrame(next);
+                    indices[slot] = next++;
+                    ready.push_back(slot);
+                }
+            }
+            span.end();
+            changed.notify_all();
+            if (!ok)
+                return;
+        }
+    }
+
+    Reader reader;
+    Policy policy;
+    std::vector<cv::Mat> buffers;
+    std::vector<int64_t> indices;
+    std::deque<int> freeSlots, ready;
+    int64_t next, drops;
+    bool eof, stop;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::thread thread;
+};
@@ -0,0 +1,150 @@
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include <fstream>
+#include <iostream>
+
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "segment-file.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Headless line segment extraction over an image list. Images are decoded and
+// detected in parallel one chunk at a time, then the chunk is appended to the
+// output file in list order, so memory stays bounded whatever the list size.
+int main(int argc, char** argv)
+{
+    cv::CommandLineParser parser(argc, argv,
+                                 "{@list    ||text file with one image path per line}"
+                                 "{output  o|segments.lsdb|output segment file}"
+                                 "{refine  r|false|if true use LSD_REFINE_STD method, if false use LSD_REFINE_NONE method}"
+                                 "{pyramid p|0|fast pass: downsample the images 2^p times before detection, coordinates are scaled back}"
+                                 "{chunk    |256|number of images processed in parallel before being written}"
+                                 "{help    h|false|show help message}"
+                                 METRICS_KEYS
+                                 TRACE_KEYS);
+
+    if (parser.get<bool>("help") || parser.get<String>("@list").empty())
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    String listFile = parser.get<String>("@list");
+    String output = parser.get<String>("output");
+    int refine = parser.get<bool>("refine") ? LSD_REFINE_STD : LSD_REFINE_NONE;
+    int levels = max(0, parser.get<int>("pyramid"));
+    int chunk = max(1, parser.get<int>("chunk"));
+
+    ifstream list(listFile.c_str());
+    if (!list.is_open())
+    {
+        cout << "Unable to load " << listFile << endl;
+        return 1;
+    }
+
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
+    metrics::Histogram& decodeTime = metrics::histogram("line_segment_batch.decode");
+    metrics::Histogram& detectTime = metrics::histogram("line_segment_batch.detect");
+    metrics::Histogram& writeTime = metrics::histogram("line_segment_batch.write");
+    metrics::Counter& imageCount = metrics::counter("line_segment_batch.images");
+    metrics::Counter& failedCount = metrics::counter("line_segment_batch.failed");
+    metrics::Counter& segmentCount = metrics::counter("line_segment_batch.segments");
+    metrics::Gauge& rate = metrics::gauge("line_segment_batch.images_per_second");
+
+    SegmentFileWriter writer(output, levels);
+    vector<String> names;
+    vector<vector<Vec4f> > segments(chunk);
+    size_t processed = 0, failed = 0, total = 0;
+    double start = double(getTickCount());
+
+    for (bool more = true; more; )
+    {
+        // read the next chunk of names
+        names.clear();
+        String line;
+        while ((int)names.size() < chunk && (more = (bool)getline(list, line)))
+            if (!line.empty())
+                names.push_back(line);
+        if (names.empty())
+            break;
+
+        parallel_for_(Range(0, (int)names.size()), [&](const Range& range) {
+            Ptr<LineSegmentDetector> ls = createLineSegmentDetector(refine);
+            Mat image;
+            for (int i = range.start; i < range.end; i++)
+            {
+                // traced under the index of the image in the list
+                trace::FrameScope traced((int64_t)(processed + i));
+                segments[i].clear();
+                // reduced decoding already does part of the downsampling
+                int flags = IMREAD_GRAYSCALE;
+                int left = levels;
+                if (left >= 3) { flags = IMREAD_REDUCED_GRAYSCALE_8; left -= 3; }
+                else if (left == 2) { flags = IMREAD_REDUCED_GRAYSCALE_4; left -= 2; }
+                else if (left == 1) { flags = IMREAD_REDUCED_GRAYSCALE_2; left -= 1; }
+                {
+                    metrics::ScopedTimer timer(decodeTime);
+                    TRACE_SCOPE("decode");
+                    image = imread(names[i], flags);
+                    if (image.empty())
+                        continue;
+                    for (int l = 0; l < left; l++)
+                        pyrDown(image, image);
+                }
+
+                metrics::ScopedTimer timer(detectTime);
+                TRACE_SCOPE("detect");
+                ls->detect(image, segments[i]);
+                if (levels > 0)
+                {
+                    float s = float(1 << levels);
+                    for (size_t k = 0; k < segments[i].size(); k++)
+                        segments[i][k] *= s;
+                }
+            }
+        });
+
+        {
+            metrics::ScopedTimer timer(writeTime);
+            TRACE_SCOPE("write");
+            for (size_t i = 0; i < names.size(); i++)
+            {
+                if (segments[i].empty())
+                {
+                    failed++;
+                    failedCount.add();
+                }
+                total += segments[i].size();
+                segmentCount.add(segments[i].size());
+                writer.append(segments[i]);
+            }
+        }
+        processed += names.size();
+        imageCount.add(names.size());
+
+        double elapsed = (double(getTickCount()) - start) / getTickFrequency();
+        rate.set(processed / elapsed);
+        cout << processed << " images, " << total << " segments, "
+             << processed / elapsed << " images/s" << endl;
+    }
+    if (!writer.close())
+    {
+        cout << "Failed to write " << output << endl;
+        return 1;
+    }
+
+    if (failed)
+        cout << failed << " images were unreadable or without segments" << endl;
+    cout << "Wrote " << output << endl;
+    return 0;
+}
+
+/*
+Example usage:
+
+    find /path/to/frames -name '*.jpg' > frames.txt
+    ./build/line-segment-batch frames.txt --output=frames.lsdb --pyramid=1
+*/
@@ -2,6 +2,10 @@
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/highgui.hpp"
 #include <iostream>
+
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "tiled-lsd.hpp"
  
 using namespace std;
 using namespace cv;
@@ -13,7 +17,12 @@ int main(int argc, char** argv)
                                  "{refine  r|false|if true use LSD_REFINE_STD method, if false use LSD_REFINE_NONE method}"
                                  "{canny   c|false|use Canny edge detector}"
                                  "{overlay o|false|show result on input image}"
-                                 "{help    h|false|show help message}");
+                                 "{tiled   t|false|split the image into overlapping tiles detected in parallel, for very large images}"
+                                 "{tile     |1024|tiled mode: size of a tile in pixels}"
+                                 "{overlap  |32|tiled mode: overlap between neighbouring tiles in pixels}"
+                                 "{help    h|false|show help message}"
+                                 METRICS_KEYS
+                                 TRACE_KEYS);
  
     if (parser.get<bool>("help"))
     {
@@ -27,8 +36,19 @@ int main(int argc, char** argv)
     bool useRefine = parser.get<bool>("refine");
     bool useCanny = parser.get<bool>("canny");
     bool overlay = parser.get<bool>("overlay");
- 
-    Mat image = imread(filename, IMREAD_GRAYSCALE);
+    bool useTiles = parser.get<bool>("tiled");
+    TiledLsdParams tiledParams;
+    tiledParams.tileSize = parser.get<int>("tile");
+    tiledParams.overlap = parser.get<int>("overlap");
+    tiledParams.refine = useRefine ? LSD_REFINE_STD : LSD_REFINE_NONE;
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
+ 
+    Mat image;
+    {
+        TRACE_SCOPE("decode");
+        image = imread(filename, IMREAD_GRAYSCALE);
+    }
  
     if( image.empty() )
     {
@@ -46,13 +66,20 @@ int main(int argc, char** argv)
     // Create and LSD detector with standard or no refinement.
     Ptr<LineSegmentDetector> ls = useRefine ? createLineSegmentDetector(LSD_REFINE_STD) : createLineSegmentDetector(LSD_REFINE_NONE);
  
-    double start = double(getTickCount());
+    metrics::ScopedTimer timer(metrics::histogram(useTiles ? "line_segment.detect_tiled" : "line_segment.detect"));
     vector<Vec4f> lines_std;
  
     // Detect the lines
-    ls->detect(image, lines_std);
+    {
+        TRACE_SCOPE("detect");
+        if (useTiles)
+            detectLinesTiled(image, lines_std, tiledParams);
+        else
+            ls->detect(image, lines_std);
+    }
  
-    double duration_ms = (double(getTickCount()) - start) * 1000 / getTickFrequency();
+    double duration_ms = timer.stop();
+    metrics::counter("line_segment.segments").add(lines_std.size());
     std::cout << "It took " << duration_ms << " ms." << std::endl;
  
     // Show found lines
@@ -65,6 +92,7 @@ int main(int argc, char** argv)
  
     String window_name = useRefine ? "Result - standard refinement" : "Result - no refinement";
     window_name += useCanny ? " - Canny edge detector used" : "";
+    window_name += useTiles ? " - tiled" : "";
  
     imshow(window_name, image);
  
@@ -75,6 +103,6 @@ int main(int argc, char** argv)
 /*
 Example usage:
 
-    ./build/application --input=/home/pc/dev/dataset/camouflaged/cod10k-v3/train/images/COD10K-CAM-1-Aquatic-3-Crab-36.jpg
+    ./build/line-segment --input=/home/pc/dev/dataset/camouflaged/cod10k-v3/train/images/COD10K-CAM-1-Aquatic-3-Crab-36.jpg
  
 */
\ No newline at end of file
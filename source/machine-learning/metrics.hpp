@@ -0,0 +1,510 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define METRICS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define METRICS_TSC 1
+#endif
+
+// Options of metrics::Reporter, to append to the keys of a CommandLineParser.
+#define METRICS_KEYS \
+    "{ metrics-json   |    | write the metrics as JSON to this file }" \
+    "{ metrics-prom   |    | write the metrics in the Prometheus text format to this file }" \
+    "{ metrics-period | 10 | seconds between two writes of the metrics }"
+
+// Scoped timer on the histogram `name`, created on first use.
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_SCOPE(name) \
+    static metrics::Histogram& METRICS_CONCAT(metricsHistogram, __LINE__) = metrics::histogram(name); \
+    metrics::ScopedTimer METRICS_CONCAT(metricsTimer, __LINE__)(METRICS_CONCAT(metricsHistogram, __LINE__))
+
+// Latency histograms, counters and gauges cheap enough to stay enabled.
+//
+// Histograms and counters are sharded per thread: a thread only writes its
+// own shard, with relaxed atomic loads and stores and no lock, and a reader
+// sums the shards. A scoped timer reads the time stamp counter twice and
+// increments a few shard fields, a few tens of nanoseconds. Histograms keep
+// raw ticks in log-linear buckets (32 per power of two, about 3% relative
+// error, HDR histogram style), converted to seconds when read.
+namespace metrics {
+
+static const int kSubBits = 5;
+static const int kMaxBits = 44;     // longer durations go to the last bucket
+static const int kBuckets = (kMaxBits - kSubBits + 1) << kSubBits;
+
+inline uint64_t ticks()
+{
+#ifdef METRICS_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Seconds per tick, measured once against the steady clock.
+inline double secondsPerTick()
+{
+    static const double value = [] {
+#ifdef METRICS_TSC
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t c1 = ticks();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return c1 > c0 ? s / (double)(c1 - c0) : 1e-9;
+#else
+        return 1e-9;
+#endif
+    }();
+    return value;
+}
+
+inline int bucketOf(uint64_t v)
+{
+    if (v < (1u << kSubBits))
+        return (int)v;
+    if (v >> kMaxBits)
+        return kBuckets - 1;
+#if defined(__GNUC__)
+    int e = 63 - __builtin_clzll(v);
+#else
+    int e = 63;
+    while (!(v >> e))
+        e--;
+#endif
+    int shift = e - kSubBits;
+    return ((shift + 1) << kSubBits) + (int)(v >> shift) - (1 << kSubBits);
+}
+
+// Smallest value of bucket i, the bucket being 2^width wide.
+inline uint64_t bucketLow(int i, int& width)
+{
+    if (i < (1 << kSubBits))
+    {
+        width = 0;
+        return (uint64_t)i;
+    }
+    width = (i >> kSubBits) - 1;
+    return (uint64_t)((i & ((1 << kSubBits) - 1)) + (1 << kSubBits)) << width;
+}
+
+// Single writer increment, no read-modify-write instruction needed.
+inline void bump(std::atomic<uint64_t>& a, uint64_t v)
+{
+    a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+// Per thread shards of a metric. The shard of a thread is looked up in a
+// thread local table indexed by the metric id, shards are never freed so
+// the counts of finished threads are kept.
+template<typename S>
+class Sharded
+{
+public:
+    Sharded(const std::string& name_) : name(name_), id(nextId()++) {}
+
+    S& local()
+    {
+        thread_local std::vector<S*> cache;
+        if (id < cache.size() && cache[id])
+            return *cache[id];
+        std::lock_guard<std::mutex> lock(mutex);
+        shards.emplace_back(new S());
+        if (cache.size() <= id)
+            cache.resize(id + 1, NULL);
+        cache[id] = shards.back().get();
+        return *cache[id];
+    }
+
+    template<typename F>
+    void forEach(F f) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < shards.size(); i++)
+            f(*shards[i]);
+    }
+
+    const std::string name;
+
+private:
+    static size_t& nextId()
+    {
+        static size_t n = 0;    // ids are given under the registry lock
+        return n;
+    }
+
+    const size_t id;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<S> > shards;
+};
+
+struct alignas(64) HistogramShard
+{
+    std::atomic<uint64_t> count{0}, sum{0}, min{UINT64_MAX}, max{0};
+    std::atomic<uint64_t> buckets[kBuckets] = {};
+};
+
+struct alignas(64) CounterShard
+{
+    std::atomic<uint64_t> value{0};
+};
+
+// Merged view of a histogram, in seconds.
+struct HistogramSnapshot
+{
+    uint64_t count = 0;
+    double sum = 0, min = 0, max = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0;
+};
+
+class Histogram : public Sharded<HistogramShard>
+{
+public:
+    explicit Histogram(const std::string& name_) : Sharded<HistogramShard>(name_) {}
+
+    void recordTicks(uint64_t t)
+    {
+        HistogramShard& s = local();
+        bump(s.count, 1);
+        bump(s.sum, t);
+        bump(s.buckets[bucketOf(t)], 1);
+        if (t < s.min.load(std::memory_order_relaxed))
+            s.min.store(t, std::memory_order_relaxed);
+        if (t > s.max.load(std::memory_order_relaxed))
+            s.max.store(t, std::memory_order_relaxed);
+    }
+
+    void record(double seconds)
+    {
+        recordTicks((uint64_t)(std::max(0.0, seconds) / secondsPerTick()));
+    }
+
+    HistogramSnapshot snapshot() const
+    {
+        std::vector<uint64_t> buckets(kBuckets, 0);
+        uint64_t count = 0, sum = 0, lo = UINT64_MAX, hi = 0;
+        forEach([&](const HistogramShard& s) {
+            count += s.count.load(std::memory_order_relaxed);
+            sum += s.sum.load(std::memory_order_relaxed);
+            lo = std::min(lo, s.min.load(std::memory_order_relaxed));
+            hi = std::max(hi, s.max.load(std::memory_order_relaxed));
+            for (int i = 0; i < kBuckets; i++)
+                buckets[i] += s.buckets[i].load(std::memory_order_relaxed);
+        });
+
+        HistogramSnapshot r;
+        const double spt = secondsPerTick();
+        r.count = count;
+        if (count == 0)
+            return r;
+        r.sum = sum * spt;
+        r.min = lo * spt;
+        r.max = hi * spt;
+        const double q[] = {0.5, 0.9, 0.99, 0.999};
+        double* out[] = {&r.p50, &r.p90, &r.p99, &r.p999};
+        for (int k = 0; k < 4; k++)
+        {
+            // middle of the bucket holding the rank, within the seen range
+            uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q[k] * count)), seen = 0;
+            int i = 0;
+            while (i < kBuckets - 1 && (seen += buckets[i]) < rank)
+                i++;
+            int width;
+            double mid = (double)bucketLow(i, width) + (width ? (double)(1ULL << width) / 2 : 0);
+            *out[k] = std::min(std::max(mid, (double)lo), (double)hi) * spt;
+        }
+        return r;
+    }
+};
+
+class Counter : public Sharded<CounterShard>
+{
+public:
+    explicit Counter(const std::string& name_) : Sharded<CounterShard>(name_) {}
+
+    void add(uint64_t n = 1) { bump(local().value, n); }
+
+    uint64_t value() const
+    {
+        uint64_t v = 0;
+        forEach([&](const CounterShard& s) { v += s.value.load(std::memory_order_relaxed); });
+        return v;
+    }
+};
+
+// Last value set, from any thread.
+class Gauge
+{
+public:
+    explicit Gauge(const std::string& name_) : name(name_), current(0) {}
+
+    void set(double v) { current.store(v, std::memory_order_relaxed); }
+    double value() const { return current.load(std::memory_order_relaxed); }
+
+    const std::string name;
+
+private:
+    std::atomic<double> current;
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Histogram> > histograms;
+    std::map<std::string, std::unique_ptr<Counter> > counters;
+    std::map<std::string, std::unique_ptr<Gauge> > gauges;
+
+    static Registry& instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    template<typename M>
+    static M& get(std::map<std::string, std::unique_ptr<M> >& metrics, const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        std::unique_ptr<M>& m = metrics[name];
+        if (!m)
+            m.reset(new M(name));
+        return *m;
+    }
+};
+
+// Metrics are created on first use and live until the end of the program,
+// keep the returned reference rather than looking the name up every time.
+inline Histogram& histogram(const std::string& name)
+{
+    secondsPerTick();   // calibrated now rather than on the first read
+    return Registry::get(Registry::instance().histograms, name);
+}
+
+inline Counter& counter(const std::string& name)
+{
+    return Registry::get(Registry::instance().counters, name);
+}
+
+inline Gauge& gauge(const std::string& name)
+{
+    return Registry::get(Registry::instance().gauges, name);
+}
+
+// Records the time from its construction to stop() or its destruction.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Histogram& h) : hist(&h), start(ticks()) {}
+    ~ScopedTimer() { stop(); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // Record now, returns the time in milliseconds (0 when already stopped).
+    double stop()
+    {
+        if (!hist)
+            return 0;
+        uint64_t t = ticks() - start;
+        hist->recordTicks(t);
+        hist = NULL;
+        return t * secondsPerTick() * 1000;
+    }
+
+private:
+    Histogram* hist;
+    uint64_t start;
+};
+
+// Prometheus metric name: [a-zA-Z_:][a-zA-Z0-9_:]*
+inline std::string promName(const std::string& name)
+{
+    std::string r = name;
+    for (size_t i = 0; i < r.size(); i++)
+    {
+        char c = r[i];
+        if (!(isalnum((unsigned char)c) || c == '_' || c == ':'))
+            r[i] = '_';
+    }
+    if (r.empty() || isdigit((unsigned char)r[0]))
+        r = "_" + r;
+    return r;
+}
+
+inline std::string jsonString(const std::string& s)
+{
+    std::string r = "\"";
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+            r += '\\';
+        r += s[i];
+    }
+    return r + "\"";
+}
+
+template<typename H, typename C, typename G>
+void forEachMetric(H histogramFn, C counterFn, G gaugeFn)
+{
+    Registry& reg = Registry::instance();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto it = reg.histograms.begin(); it != reg.histograms.end(); ++it)
+        histogramFn(*it->second);
+    for (auto it = reg.counters.begin(); it != reg.counters.end(); ++it)
+        counterFn(*it->second);
+    for (auto it = reg.gauges.begin(); it != reg.gauges.end(); ++it)
+        gaugeFn(*it->second);
+}
+
+// All the metrics as one JSON object, durations in milliseconds.
+inline std::string toJson()
+{
+    std::string h, c, g;
+    forEachMetric(
+        [&](const Histogram& m) {
+            HistogramSnapshot s = m.snapshot();
+            h += (h.empty() ? "" : ",") + cv::format("\n    %s: {\"count\": %llu, \"sum_ms\": %.6f, \"min_ms\": %.6f, "
+                                                     "\"max_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, "
+                                                     "\"p99_ms\": %.6f, \"p999_ms\": %.6f}",
+                                                     jsonString(m.name).c_str(), (unsigned long long)s.count,
+                                                     s.sum * 1e3, s.min * 1e3, s.max * 1e3, s.p50 * 1e3,
+                                                     s.p90 * 1e3, s.p99 * 1e3, s.p999 * 1e3);
+        },
+        [&](const Counter& m) {
+            c += (c.empty() ? "" : ",") + cv::format("\n    %s: %llu", jsonString(m.name).c_str(), (unsigned long long)m.value());
+        },
+        [&](const Gauge& m) {
+            g += (g.empty() ? "" : ",") + cv::format("\n    %s: %.9g", jsonString(m.name).c_str(), m.value());
+        });
+    return "{\n  \"histograms\": {" + h + "\n  },\n  \"counters\": {" + c + "\n  },\n  \"gauges\": {" + g + "\n  }\n}\n";
+}
+
+// All the metrics in the Prometheus text format, histograms as summaries in seconds.
+inline std::string toPrometheus()
+{
+    std::string r;
+    forEachMetric(
+        [&](const Histogram& m) {
+            HistogramSnapshot s = m.snapshot();
+            std::string n = promName(m.name) + "_seconds";
+            r += "# TYPE " + n + " summary\n";
+            r += cv::format("%s{quantile=\"0.5\"} %.9g\n%s{quantile=\"0.9\"} %.9g\n", n.c_str(), s.p50, n.c_str(), s.p90);
+            r += cv::format("%s{quantile=\"0.99\"} %.9g\n%s{quantile=\"0.999\"} %.9g\n", n.c_str(), s.p99, n.c_str(), s.p999);
+            r += cv::format("%s_sum %.9g\n%s_count %llu\n", n.c_str(), s.sum, n.c_str(), (unsigned long long)s.count);
+        },
+        [&](const Counter& m) {
+            std::string n = promName(m.name) + "_total";
+            r += "# TYPE " + n + " counter\n" + cv::format("%s %llu\n", n.c_str(), (unsigned long long)m.value());
+        },
+        [&](const Gauge& m) {
+            std::string n = promName(m.name);
+            r += "# TYPE " + n + " gauge\n" + cv::format("%s %.9g\n", n.c_str(), m.value());
+        });
+    return r;
+}
+
+// Written next to the file and renamed, readers never see a partial file.
+inline bool writeFile(const std::string& path, const std::string& text)
+{
+    std::string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(temp.c_str(), path.c_str()) == 0;
+}
+
+// Writes the metrics to a JSON and/or a Prometheus file every period
+// seconds, from its own thread, and once more when destroyed. An empty path
+// disables that output, with both empty nothing runs.
+class Reporter
+{
+public:
+    Reporter(const std::string& jsonPath_, const std::string& promPath_, double period_ = 10)
+        : jsonPath(jsonPath_), promPath(promPath_), period(std::max(0.1, period_)), stop(false)
+    {
+        if (!jsonPath.empty() || !promPath.empty())
+            thread = std::thread(&Reporter::run, this);
+    }
+
+    // From the options of METRICS_KEYS.
+    explicit Reporter(const cv::CommandLineParser& parser)
+        : Reporter(parser.get<std::string>("metrics-json"), parser.get<std::string>("metrics-prom"),
+                   parser.get<double>("metrics-period")) {}
+
+    ~Reporter()
+    {
+        if (!thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        changed.notify_all();
+        thread.join();
+        write();
+    }
+
+    Reporter(const Reporter&) = delete;
+    Reporter& operator=(const Reporter&) = delete;
+
+    void write()
+    {
+        if (!jsonPath.empty() && !writeFile(jsonPath, toJson()))
+            fprintf(stderr, "Can not write the metrics to %s\n", jsonPath.c_str());
+        if (!promPath.empty() && !writeFile(promPath, toPrometheus()))
+            fprintf(stderr, "Can not write the metrics to %s\n", promPath.c_str());
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!changed.wait_for(lock, std::chrono::duration<double>(period), [&] { return stop; }))
+        {
+            lock.unlock();
+            write();
+            lock.lock();
+        }
+    }
+
+    std::string jsonPath, promPath;
+    double period;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stop;
+    std::thread thread;
+};
+
+// Output file named by an environment variable, for the tools without
+// options, e.g. Reporter reporter(pathFromEnv("METRICS_JSON"), pathFromEnv("METRICS_PROM")).
+inline std::string pathFromEnv(const char* name)
+{
+    const char* value = std::getenv(name);
+    return value ? value : "";
+}
+
+} // namespace metrics
@@ -0,0 +1,230 @@
+#include <opencv2/dnn.hpp>
+#include <opencv2/objdetect.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/videoio.hpp>
+#include <iostream>
+#include <mutex>
+
+#include "common.hpp"
+#include "colorize-segmentation.hpp"
+#include "frame-graph.hpp"
+#include "frame-source.hpp"
+#include "metrics.hpp"
+#include "preprocess.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+using namespace dnn;
+using namespace std;
+
+static const string keys =
+    "{ help h      |     | print help message }"
+    "{ camera c    | 0   | capture video from camera (device index starting from 0) }"
+    "{ video v     |     | use video as input }"
+    "{ cascade     | haarcascades/haarcascade_frontalface_alt.xml | face cascade }"
+    "{ scale       | 1.3 | image downscale of the face detection }"
+    "{ pose        |     | OpenPose COCO .caffemodel, no pose without it }"
+    "{ pose-proto  |     | OpenPose COCO .prototxt }"
+    "{ segm        |     | alias of a segmentation model of the zoo file, no segmentation without it }"
+    "{ zoo         | models.yml | zoo file of the segmentation models }"
+    "{ workers     | 0   | worker threads, 0 for one per core }"
+    "{ inflight    | 3   | frames in the graph at the same time }"
+    "{ show        |     | display the combined results }"
+    METRICS_KEYS
+    TRACE_KEYS;
+
+int main(int argc, char** argv)
+{
+    CommandLineParser parser(argc, argv, keys);
+    parser.about("Face detection, people detection, pose and segmentation on the same frames, "
+                 "one decode fanned out to all the analysers.");
+    if (parser.has("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+    int camera = parser.get<int>("camera");
+    string file = parser.get<string>("video");
+    double scale = parser.get<double>("scale");
+    bool show = parser.has("show");
+    if (!parser.check())
+    {
+        parser.printErrors();
+        return 1;
+    }
+
+    CascadeClassifier cascade;
+    if (!cascade.load(samples::findFile(parser.get<string>("cascade"))))
+    {
+        cerr << "ERROR: Could not load classifier cascade" << endl;
+        return -1;
+    }
+    HOGDescriptor hog;
+    hog.setSVMDetector(HOGDescriptor::getDefaultPeopleDetector());
+
+    FrameGraph::Params params;
+    params.workers = parser.get<int>("workers");
+    params.maxInFlight = parser.get<int>("inflight");
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
+    FrameGraph graph(params);
+
+    // one grayscale conversion shared by the cascade and HOG
+    int gray = graph.addStage("gray", FrameGraph::FRAME, [](const Mat& frame, Mat& out) {
+        cvtColor(frame, out, COLOR_BGR2GRAY);
+    });
+
+    Mat smallImg;
+    int faces = graph.addAnalyser("faces", {gray}, [&](const vector<Mat>& in, AnalysisResult& r) {
+        resize(in[0], smallImg, Size(), 1 / scale, 1 / scale, INTER_LINEAR_EXACT);
+        equalizeHist(smallImg, smallImg);
+        cascade.detectMultiScale(smallImg, r.boxes, 1.1, 2, CASCADE_SCALE_IMAGE, Size(30, 30));
+        for (size_t i = 0; i < r.boxes.size(); i++)
+        {
+            Rect& b = r.boxes[i];
+            b = Rect(cvRound(b.x * scale), cvRound(b.y * scale), cvRound(b.width * scale), cvRound(b.height * scale));
+        }
+    });
+
+    int people = graph.addAnalyser("people", {gray}, [&](const vector<Mat>& in, AnalysisResult& r) {
+        hog.detectMultiScale(in[0], r.boxes, 0, Size(8, 8), Size(), 1.05, 2, false);
+    });
+
+    // COCO body parts, the most confident location of each heatmap
+    int pose = -1;
+    Net poseNet;
+    PreprocessSpec poseSpec;
+    poseSpec.size = Size(368, 368);
+    poseSpec.scale = 1.0 / 255;
+    PreprocessKernel poseKernel(poseSpec);
+    Mat poseBlob;
+    if (parser.has("pose"))
+    {
+        poseNet = readNet(parser.get<string>("pose"), parser.get<string>("pose-proto"));
+        pose = graph.addAnalyser("pose", {FrameGraph::FRAME}, [&](const vector<Mat>& in, AnalysisResult& r) {
+            poseKernel.run(in[0], poseBlob);
+            poseNet.setInput(poseBlob);
+            Mat heatmaps = poseNet.forward();
+            int H = heatmaps.size[2], W = heatmaps.size[3];
+            for (int n = 0; n < 18; n++)
+            {
+                Mat heatMap(H, W, CV_32F, (void*)heatmaps.ptr(0, n));
+                Point pm;
+                double conf;
+                minMaxLoc(heatMap, 0, &conf, 0, &pm);
+                r.points.push_back(conf > 0.1 ? Point2f(pm.x * (float)in[0].cols / W, pm.y * (float)in[0].rows / H)
+                                              : Point2f(-1, -1));
+            }
+        });
+    }
+
+    // colored arg-max classes, at the resolution of the network
+    int segmentation = -1;
+    Net segmNet;
+    PreprocessKernel segmKernel;
+    Mat segmBlob;
+    vector<Vec3b> colors;
+    if (parser.has("segm"))
+    {
+        const ModelSpec* spec = ModelZoo::get(parser.get<string>("zoo"))->find(parser.get<string>("segm"));
+        if (!spec)
+        {
+            cerr << "ERROR: " << parser.get<string>("segm") << " is not in the zoo file" << endl;
+            return -1;
+        }
+        segmNet = readNet(findFile(spec->model), findFile(spec->config));
+        segmKernel = PreprocessKernel(spec->preprocess());
+        segmentation = graph.addAnalyser("segmentation", {FrameGraph::FRAME}, [&](const vector<Mat>& in, AnalysisResult& r) {
+            segmKernel.run(in[0], segmBlob);
+            segmNet.setInput(segmBlob);
+            Mat score = segmNet.forward();
+            colorizeSegmentation(score, r.mask, colors);
+        });
+    }
+
+    // combined record of each frame, in frame order
+    mutex displayMutex;
+    Mat display;
+    graph.setJoin([&](const FrameRecord& record) {
+        const vector<AnalysisResult>& res = record.results;
+        cout << "frame " << record.frame.index << ": " << res[faces].boxes.size() << " faces, "
+             << res[people].boxes.size() << " people";
+        if (pose >= 0)
+        {
+            int found = 0;
+            for (size_t i = 0; i < res[pose].points.size(); i++)
+                found += res[pose].points[i].x >= 0;
+            cout << ", " << found << " body parts";
+        }
+        cout << ", latency " << record.latency << " ms (";
+        for (int i = 0; i < graph.analyserCount(); i++)
+            cout << (i ? ", " : "") << graph.analyserName(i) << " " << res[i].ms << " ms";
+        cout << ")" << endl;
+
+        if (!show)
+            return;
+        // the frame is ours until the join returns
+        Mat img = record.frame.image;
+        if (segmentation >= 0)
+        {
+            Mat segm;
+            resize(res[segmentation].mask, segm, img.size(), 0, 0, INTER_NEAREST);
+            addWeighted(img, 0.7, segm, 0.3, 0, img);
+        }
+        for (size_t i = 0; i < res[people].boxes.size(); i++)
+            rectangle(img, res[people].boxes[i], Scalar(0, 255, 0), 2);
+        for (size_t i = 0; i < res[faces].boxes.size(); i++)
+            rectangle(img, res[faces].boxes[i], Scalar(255, 0, 0), 2);
+        if (pose >= 0)
+            for (size_t i = 0; i < res[pose].points.size(); i++)
+                if (res[pose].points[i].x >= 0)
+                    circle(img, res[pose].points[i], 3, Scalar(0, 0, 255), -1);
+        lock_guard<mutex> lock(displayMutex);
+        img.copyTo(display);
+    });
+
+    VideoCapture cap;
+    if (file.empty())
+        cap.open(camera);
+    else
+        cap.open(samples::findFileOrKeep(file));
+    if (!cap.isOpened())
+    {
+        cout << "Can not open video stream: '" << (file.empty() ? "<camera>" : file) << "'" << endl;
+        return 2;
+    }
+
+    // the ring holds the frames in the graph plus the one being decoded
+    FrameSource source([&cap](Mat& m) { return cap.read(m); }, params.maxInFlight + 2,
+                       file.empty() ? FrameSource::DropOldest : FrameSource::Block);
+    FrameSource::Frame frame;
+    Mat shown;
+    while (source.read(frame))
+    {
+        graph.submit(frame);
+        frame.release();
+        if (show)
+        {
+            {
+                lock_guard<mutex> lock(displayMutex);
+                display.copyTo(shown);
+            }
+            if (!shown.empty())
+                imshow("Multi-model", shown);
+            char key = (char)waitKey(1);
+            if (key == 27 || key == 'q')
+                break;
+        }
+    }
+    graph.flush();
+    return 0;
+}
+
+/*
+Example usage:
+    ./build/multi-model --video=vtest.avi \
+        --pose=/home/pc/dev/opencv/models/openpose/pose_iter_440000.caffemodel \
+        --pose-proto=/home/pc/dev/opencv/models/openpose/openpose_pose_coco.prototxt \
+        --segm=fcn8s --zoo=models.yml --show
+*/
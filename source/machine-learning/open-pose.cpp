@@ -20,11 +20,18 @@
 #include <opencv2/dnn.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
+#include <opencv2/videoio.hpp>
 using namespace cv;
 using namespace cv::dnn;
  
+#include <fstream>
 #include <iostream>
 using namespace std;
+
+#include "batch-infer.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "preprocess.hpp"
  
  
 // connection table, in the format [model_id][pair_id][from/to]
@@ -54,30 +61,173 @@ const int POSE_PAIRS[3][20][2] = {
     {0,17}, {17,18}, {18,19}, {19,20}   // small
 }};
  
+// One-Euro filter (Casiez et al. 2012): a low-pass filter whose cutoff
+// frequency grows with the speed of the signal, so slow keypoints are
+// smoothed strongly while fast motions keep a low lag.
+class OneEuroFilter
+{
+    double mincutoff, beta, dcutoff;
+    double xPrev, dxPrev;
+    bool initialized;
+
+    static double alpha(double cutoff, double dt)
+    {
+        double tau = 1.0 / (2 * CV_PI * cutoff);
+        return 1.0 / (1.0 + tau / dt);
+    }
+public:
+    OneEuroFilter(double mincutoff_ = 1.0, double beta_ = 0.0, double dcutoff_ = 1.0)
+        : mincutoff(mincutoff_), beta(beta_), dcutoff(dcutoff_), xPrev(0), dxPrev(0), initialized(false) {}
+
+    void reset() { initialized = false; }
+
+    double filter(double x, double dt)
+    {
+        if (!initialized)
+        {
+            xPrev = x;
+            dxPrev = 0;
+            initialized = true;
+            return x;
+        }
+        double ad = alpha(dcutoff, dt);
+        double dx = ad * (x - xPrev) / dt + (1 - ad) * dxPrev;
+        double a = alpha(mincutoff + beta * fabs(dx), dt);
+        xPrev = a * x + (1 - a) * xPrev;
+        dxPrev = dx;
+        return xPrev;
+    }
+};
+
+// Pick the most confident location in each part heatmap of a network
+// output and map it back into the roi it was computed on, in full image
+// coordinates. Parts below the threshold are set to (-1,-1).
+static vector<Point2f> heatmapKeypoints(const Mat& result, const Rect& roi, float thresh, int nparts)
+{
+    // the result is an array of "heatmaps", the probability of a body part being in location x,y
+    int H = result.size[2];
+    int W = result.size[3];
+    float SX = float(roi.width) / W;
+    float SY = float(roi.height) / H;
+
+    // find the position of the body parts
+    vector<Point2f> points(nparts, Point2f(-1, -1));
+    for (int n=0; n<nparts; n++)
+    {
+        // Slice heatmap of corresponding body's part.
+        Mat heatMap(H, W, CV_32F, (void*)result.ptr(0,n));
+        // 1 maximum per heatmap
+        Point pm;
+        double conf;
+        minMaxLoc(heatMap, 0, &conf, 0, &pm);
+        if (conf > thresh)
+            points[n] = Point2f(roi.x + pm.x * SX, roi.y + pm.y * SY);
+    }
+    return points;
+}
+
+// Run the network on the roi of the image and return one keypoint per part.
+// The blob size is scaled with the roi so the pixel density seen by the
+// network stays the same as for a full frame of size inpSize.
+static vector<Point2f> detectKeypoints(Net& net, const Mat& img, const Rect& roi, Size inpSize,
+                                       float scale, float thresh, int nparts)
+{
+    Size blobSize = inpSize;
+    if (roi.size() != img.size())
+    {
+        // the heatmaps have a stride of 8, keep the blob aligned to it
+        blobSize.width  = std::max(64, (inpSize.width  * roi.width  / img.cols + 7) & ~7);
+        blobSize.height = std::max(64, (inpSize.height * roi.height / img.rows + 7) & ~7);
+    }
+
+    PreprocessSpec spec;
+    spec.size = blobSize;
+    spec.scale = scale;
+    Mat inputBlob;
+    PreprocessKernel(spec).run(img(roi), inputBlob);
+    Mat result;
+    {
+        TRACE_SCOPE("net.forward");
+        net.setInput(inputBlob);
+        result = net.forward();
+    }
+    TRACE_SCOPE("keypoints");
+    return heatmapKeypoints(result, roi, thresh, nparts);
+}
+
+static void drawSkeleton(Mat& img, const vector<Point2f>& points, int midx, int npairs)
+{
+    for (int n=0; n<npairs; n++)
+    {
+        // lookup 2 connected body/hand parts
+        Point2f a = points[POSE_PAIRS[midx][n][0]];
+        Point2f b = points[POSE_PAIRS[midx][n][1]];
+
+        // we did not find enough confidence before
+        if (a.x<=0 || a.y<=0 || b.x<=0 || b.y<=0)
+            continue;
+
+        line(img, a, b, Scalar(0,200,0), 2);
+        circle(img, a, 3, Scalar(0,0,200), -1);
+        circle(img, b, 3, Scalar(0,0,200), -1);
+    }
+}
+
+// Padded bounding box around the detected keypoints, clipped to the frame.
+// Returns an empty rect if too few parts were found to trust the box.
+static Rect trackingRoi(const vector<Point2f>& points, Size frameSize, float pad)
+{
+    vector<Point2f> found;
+    for (size_t i = 0; i < points.size(); i++)
+        if (points[i].x >= 0 && points[i].y >= 0)
+            found.push_back(points[i]);
+    if (found.size() < std::max<size_t>(3, points.size() / 3))
+        return Rect();
+
+    Rect box = boundingRect(found);
+    int margin = cvRound(pad * std::max(box.width, box.height));
+    box.x -= margin;
+    box.y -= margin;
+    box.width += 2 * margin;
+    box.height += 2 * margin;
+    return box & Rect(Point(0, 0), frameSize);
+}
+
 int main(int argc, char **argv)
 {
     CommandLineParser parser(argc, argv,
         "{ h help           | false     | print this help message }"
         "{ p proto          |           | (required) model configuration, e.g. hand/pose.prototxt }"
         "{ m model          |           | (required) model weights, e.g. hand/pose_iter_102000.caffemodel }"
-        "{ i image          |           | (required) path to image file (containing a single person, or hand) }"
+        "{ i image          |           | path to image file (containing a single person, or hand) }"
+        "{ v video          |           | path to video file or camera index, tracks the pose over the frames instead of a single image }"
+        "{ l list           |           | text file with one image path per line, the images are run through the network in batches }"
+        "{ b batch          |  8        | list mode: number of images per forward pass }"
         "{ d dataset        |           | specify what kind of model was trained. It could be (COCO, MPI, HAND) depends on dataset. }"
         "{ width            |  368      | Preprocess input image by resizing to a specific width. }"
         "{ height           |  368      | Preprocess input image by resizing to a specific height. }"
         "{ t threshold      |  0.1      | threshold or confidence value for the heatmap }"
         "{ s scale          |  0.003922 | scale for blob }"
+        "{ refresh          |  30       | video mode: run on the full frame every N frames, crop around the previous skeleton otherwise }"
+        "{ pad              |  0.3      | video mode: padding around the previous skeleton, relative to its size }"
+        "{ mincutoff        |  1.0      | video mode: One-Euro filter minimum cutoff frequency (Hz) }"
+        "{ beta             |  0.05     | video mode: One-Euro filter speed coefficient }"
+        METRICS_KEYS
+        TRACE_KEYS
     );
  
     String modelTxt = samples::findFile(parser.get<string>("proto"));
     String modelBin = samples::findFile(parser.get<string>("model"));
-    String imageFile = samples::findFile(parser.get<String>("image"));
+    String videoFile = parser.get<String>("video");
+    String listFile = parser.get<String>("list");
+    String imageFile = videoFile.empty() && listFile.empty() ? samples::findFile(parser.get<String>("image")) : String();
     String dataset = parser.get<String>("dataset");
     int W_in = parser.get<int>("width");
     int H_in = parser.get<int>("height");
     float thresh = parser.get<float>("threshold");
     float scale  = parser.get<float>("scale");
  
-    if (parser.get<bool>("help") || modelTxt.empty() || modelBin.empty() || imageFile.empty())
+    if (parser.get<bool>("help") || modelTxt.empty() || modelBin.empty() || (imageFile.empty() && videoFile.empty() && listFile.empty()))
     {
         cout << "A sample app to demonstrate human or hand pose detection with a pretrained OpenPose dnn." << endl;
         parser.printMessage();
@@ -96,6 +246,140 @@ int main(int argc, char **argv)
  
     // read the network model
     Net net = readNet(modelBin, modelTxt);
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
+
+    if (!listFile.empty())
+    {
+        ifstream ifs(listFile.c_str());
+        if (!ifs.is_open())
+        {
+            std::cerr << "Can't read image list from the file: " << listFile << std::endl;
+            exit(-1);
+        }
+        vector<String> names;
+        String line;
+        while (getline(ifs, line))
+            if (!line.empty())
+                names.push_back(line);
+
+        // all images of a batch share one blob and one forward pass
+        int batch = std::max(1, parser.get<int>("batch"));
+        BatchedForward batched(net, scale, Size(W_in, H_in));
+        metrics::Histogram& batchTime = metrics::histogram("open_pose.batch_forward");
+        metrics::Counter& images = metrics::counter("open_pose.images");
+        vector<Mat> imgs;
+        for (size_t first = 0; first < names.size(); first += batch)
+        {
+            imgs.clear();
+            for (size_t i = first; i < std::min(names.size(), first + batch); i++)
+            {
+                trace::Span span("decode", (int64_t)i);
+                Mat img = imread(names[i]);
+                if (img.empty())
+                {
+                    std::cerr << "Can't read image from the file: " << names[i] << std::endl;
+                    continue;
+                }
+                imgs.push_back(img);
+            }
+
+            // a batch is traced under its first image
+            metrics::ScopedTimer timer(batchTime);
+            trace::FrameScope tracedBatch((int64_t)first);
+            const vector<Mat>& results = batched.forward(imgs);
+            double ms = timer.stop();
+            images.add(imgs.size());
+            cout << "batch of " << imgs.size() << ": " << ms << " ms" << endl;
+
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                vector<Point2f> points;
+                {
+                    trace::Span span("keypoints", (int64_t)(first + i));
+                    points = heatmapKeypoints(results[i], Rect(Point(0, 0), imgs[i].size()), thresh, nparts);
+                }
+                drawSkeleton(imgs[i], points, midx, npairs);
+                imshow("OpenPose", imgs[i]);
+                if (waitKey() == 27)
+                    return 0;
+            }
+        }
+        return 0;
+    }
+
+    if (!videoFile.empty())
+    {
+        int refresh = std::max(1, parser.get<int>("refresh"));
+        float pad = parser.get<float>("pad");
+        double mincutoff = parser.get<double>("mincutoff");
+        double beta = parser.get<double>("beta");
+
+        VideoCapture cap;
+        if (videoFile.size() == 1 && isdigit(videoFile[0]))
+            cap.open(videoFile[0] - '0');
+        else
+            cap.open(samples::findFileOrKeep(videoFile));
+        if (!cap.isOpened())
+        {
+            std::cerr << "Can't open video stream: " << videoFile << std::endl;
+            exit(-1);
+        }
+        double fps = cap.get(CAP_PROP_FPS);
+        double dt = 1.0 / (fps > 0 ? fps : 30.0);
+
+        // one filter per keypoint coordinate
+        vector<OneEuroFilter> filters(2 * nparts, OneEuroFilter(mincutoff, beta));
+        metrics::Histogram& fullTime = metrics::histogram("open_pose.detect_full");
+        metrics::Histogram& roiTime = metrics::histogram("open_pose.detect_roi");
+        vector<Point2f> points(nparts, Point2f(-1, -1));
+        Mat frame;
+        for (int nframe = 0; ; nframe++)
+        {
+            trace::FrameScope traced(nframe);
+            {
+                TRACE_SCOPE("decode");
+                cap >> frame;
+            }
+            if (frame.empty())
+                break;
+
+            // crop around the previous skeleton, falling back to the full
+            // frame periodically and whenever the track was lost
+            Rect full(Point(0, 0), frame.size());
+            Rect roi = (nframe % refresh == 0) ? Rect() : trackingRoi(points, frame.size(), pad);
+            if (roi.empty())
+                roi = full;
+
+            metrics::ScopedTimer timer(roi == full ? fullTime : roiTime);
+            points = detectKeypoints(net, frame, roi, Size(W_in, H_in), scale, thresh, nparts);
+            double ms = timer.stop();
+
+            for (int n=0; n<nparts; n++)
+            {
+                if (points[n].x < 0)
+                {
+                    filters[2*n].reset();
+                    filters[2*n+1].reset();
+                    continue;
+                }
+                points[n].x = (float)filters[2*n].filter(points[n].x, dt);
+                points[n].y = (float)filters[2*n+1].filter(points[n].y, dt);
+            }
+
+            drawSkeleton(frame, points, midx, npairs);
+            if (roi != full)
+                rectangle(frame, roi, Scalar(200,200,0), 1);
+            string label = format("%s: %.1f ms", roi == full ? "full" : "roi", ms);
+            putText(frame, label, Point(10, 20), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(0,255,0), 2);
+
+            imshow("OpenPose", frame);
+            if (waitKey(1) == 27)
+                break;
+        }
+        return 0;
+    }
+
     // and the image
     Mat img = imread(imageFile);
     if (img.empty())
@@ -104,54 +388,15 @@ int main(int argc, char **argv)
         exit(-1);
     }
  
-    // send it through the network
-    Mat inputBlob = blobFromImage(img, scale, Size(W_in, H_in), Scalar(0, 0, 0), false, false);
-    net.setInput(inputBlob);
-    Mat result = net.forward();
-    // the result is an array of "heatmaps", the probability of a body part being in location x,y
- 
-    int H = result.size[2];
-    int W = result.size[3];
- 
-    // find the position of the body parts
-    vector<Point> points(22);
-    for (int n=0; n<nparts; n++)
-    {
-        // Slice heatmap of corresponding body's part.
-        Mat heatMap(H, W, CV_32F, result.ptr(0,n));
-        // 1 maximum per heatmap
-        Point p(-1,-1),pm;
-        double conf;
-        minMaxLoc(heatMap, 0, &conf, 0, &pm);
-        if (conf > thresh)
-            p = pm;
-        points[n] = p;
-    }
+    // send it through the network and find the position of the body parts
+    vector<Point2f> points = detectKeypoints(net, img, Rect(Point(0, 0), img.size()), Size(W_in, H_in),
+                                             scale, thresh, nparts);
  
     // connect body parts and draw it !
-    float SX = float(img.cols) / W;
-    float SY = float(img.rows) / H;
-    for (int n=0; n<npairs; n++)
-    {
-        // lookup 2 connected body/hand parts
-        Point2f a = points[POSE_PAIRS[midx][n][0]];
-        Point2f b = points[POSE_PAIRS[midx][n][1]];
- 
-        // we did not find enough confidence before
-        if (a.x<=0 || a.y<=0 || b.x<=0 || b.y<=0)
-            continue;
- 
-        // scale to image size
-        a.x*=SX; a.y*=SY;
-        b.x*=SX; b.y*=SY;
- 
-        line(img, a, b, Scalar(0,200,0), 2);
-        circle(img, a, 3, Scalar(0,0,200), -1);
-        circle(img, b, 3, Scalar(0,0,200), -1);
-    }
+    drawSkeleton(img, points, midx, npairs);
  
     imshow("OpenPose", img);
     waitKey();
  
     return 0;
-}
\ No newline at end of file
+}
@@ -4,6 +4,10 @@
 #include <opencv2/videoio.hpp>
 #include <iostream>
 #include <iomanip>
+
+#include "frame-source.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
  
 using namespace cv;
 using namespace std;
@@ -45,7 +49,9 @@ public:
  
 static const string keys = "{ help h   |   | print help message }"
                            "{ camera c | 0 | capture video from camera (device index starting from 0) }"
-                           "{ video v  |   | use video as input }";
+                           "{ video v  |   | use video as input }"
+                           METRICS_KEYS
+                           TRACE_KEYS;
  
 int main(int argc, char** argv)
 {
@@ -81,24 +87,34 @@ int main(int argc, char** argv)
     cout << "Press 'q' or <ESC> to quit." << endl;
     cout << "Press <space> to toggle between Default and Daimler detector" << endl;
     Detector detector;
-    Mat frame;
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
+    metrics::Histogram& detectTime = metrics::histogram("people_detect.detect");
+    metrics::Counter& people = metrics::counter("people_detect.people");
+    FrameSource source([&cap](Mat& m) { return cap.read(m); }, 4,
+                       file.empty() ? FrameSource::DropOldest : FrameSource::Block);
+    FrameSource::Frame input;
     for (;;)
     {
-        cap >> frame;
-        if (frame.empty())
+        if (!source.read(input))
         {
             cout << "Finished reading: empty frame" << endl;
             break;
         }
-        int64 t = getTickCount();
+        Mat& frame = input.image;
+        trace::FrameScope traced(input.index);
+        metrics::ScopedTimer timer(detectTime);
+        trace::Span span("detect");
         vector<Rect> found = detector.detect(frame);
-        t = getTickCount() - t;
+        span.end();
+        double ms = timer.stop();
+        people.add(found.size());
  
         // show the window
         {
             ostringstream buf;
             buf << "Mode: " << detector.modeName() << " ||| "
-                << "FPS: " << fixed << setprecision(1) << (getTickFrequency() / (double)t);
+                << "FPS: " << fixed << setprecision(1) << (ms > 0 ? 1000 / ms : 0.0);
             putText(frame, buf.str(), Point(10, 30), FONT_HERSHEY_PLAIN, 2.0, Scalar(0, 0, 255), 2, LINE_AA);
         }
         for (vector<Rect>::iterator i = found.begin(); i != found.end(); ++i)
@@ -107,7 +123,10 @@ int main(int argc, char** argv)
             detector.adjustRect(r);
             rectangle(frame, r.tl(), r.br(), cv::Scalar(0, 255, 0), 2);
         }
-        imshow("People detector", frame);
+        {
+            TRACE_SCOPE("imshow");
+            imshow("People detector", frame);
+        }
  
         // interact with user
         const char key = (char)waitKey(1);
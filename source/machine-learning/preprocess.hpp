@@ -0,0 +1,360 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "trace.hpp"
+
+enum ResizePolicy
+{
+    RESIZE_STRETCH,     // to the input size, the aspect ratio is not kept
+    RESIZE_CROP,        // keep the aspect ratio, cover the input size and center crop
+    RESIZE_LETTERBOX    // keep the aspect ratio, fit in the input size and pad
+};
+
+enum TensorLayout
+{
+    LAYOUT_NCHW,
+    LAYOUT_NHWC
+};
+
+// Preprocessing of the input of a network, from an 8-bit image to a tensor.
+// Values are (pixel - mean) * scale / std, mean and std being in the channel
+// order of the tensor, so a default std gives cv::dnn::blobFromImage.
+struct PreprocessSpec
+{
+    cv::Size size = cv::Size(-1, -1);       // negative: the size of the image
+    ResizePolicy resize = RESIZE_STRETCH;
+    int shortestEdge = 0;                   // RESIZE_CROP: before the crop, 0 to just cover size
+    int interpolation = cv::INTER_LINEAR;   // INTER_LINEAR or INTER_AREA
+    cv::Scalar mean, std = cv::Scalar::all(1);
+    double scale = 1.0;
+    cv::Scalar padValue;                    // RESIZE_LETTERBOX, in pixel values
+    bool swapRB = false;
+    int channels = 3;                       // of the images, 1 or 3
+    TensorLayout layout = LAYOUT_NCHW;
+    int depth = CV_32F;                     // CV_32F or CV_8U
+};
+
+namespace preprocess {
+
+// Taps of an axis: output i reads the source pixels index[i*taps + k]
+// weighted by weight[i*taps + k].
+struct Axis
+{
+    int taps = 0;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+// Source to tensor mapping of one image size. Outside of roi the tensor
+// holds the padding.
+struct Geometry
+{
+    cv::Size src, dst;
+    cv::Rect roi;
+    Axis x, y;
+    int first = 0, last = 0;    // span of the source row read, in elements
+};
+
+struct Coefficients
+{
+    float alpha[3], beta[3], pad[3];
+    int order[3];
+};
+
+enum AxisMode
+{
+    AXIS_LINEAR,        // two taps, bilinear
+    AXIS_AREA,          // box of the source pixels covered by an output pixel
+    AXIS_AREA_LINEAR    // two taps, INTER_AREA when not downscaling both axes
+};
+
+// Output i of an axis of srcLen pixels resized to dstLen pixels, shifted by
+// offset pixels of the resized axis. The taps are those of cv::resize.
+inline void buildAxis(Axis& a, int srcLen, int dstLen, int offset, int count, AxisMode mode)
+{
+    double s = (double)srcLen / dstLen;
+    a.taps = mode == AXIS_AREA ? (int)std::ceil(s) + 1 : 2;
+    a.index.assign((size_t)count * a.taps, 0);
+    a.weight.assign((size_t)count * a.taps, 0.f);
+    for (int i = 0; i < count; i++)
+    {
+        int* idx = &a.index[(size_t)i * a.taps];
+        float* w = &a.weight[(size_t)i * a.taps];
+        int o = i + offset;
+        if (mode == AXIS_AREA)
+        {
+            // source pixels covered by [o s, (o + 1) s), weighted by the overlap
+            double x0 = o * s, x1 = (o + 1) * s;
+            int k = 0;
+            for (int j = (int)std::floor(x0); j < x1 && k < a.taps; j++, k++)
+            {
+                idx[k] = std::min(j, srcLen - 1);
+                w[k] = (float)((std::min<double>(j + 1, x1) - std::max<double>(j, x0)) / s);
+            }
+            for (; k < a.taps; k++)
+                idx[k] = idx[0];
+            continue;
+        }
+
+        int j;
+        float t;
+        if (mode == AXIS_AREA_LINEAR)
+        {
+            j = (int)std::floor(o * s);
+            double f = (o + 1) - (j + 1) / s;
+            t = f <= 0 ? 0.f : (float)(f - std::floor(f));
+        }
+        else
+        {
+            double f = (o + 0.5) * s - 0.5;
+            j = (int)std::floor(f);
+            t = (float)(f - j);
+        }
+        if (j < 0)
+        {
+            j = 0;
+            t = 0;
+        }
+        if (j >= srcLen - 1)
+        {
+            j = srcLen - 1;
+            t = 0;
+        }
+        idx[0] = j;
+        idx[1] = std::min(j + 1, srcLen - 1);
+        w[0] = 1 - t;
+        w[1] = t;
+    }
+}
+
+// Tensor rows of one image. The taps of the rows are summed into buf, one
+// source row in float, then the taps of the columns are applied and the
+// values normalised and stored. TAPS is the number of column taps when known
+// at compile time, 0 otherwise.
+template<typename T, int CN, bool NCHW, int TAPS>
+void runRows(const Geometry& g, const cv::Mat& src, const Coefficients& c, void* dstData,
+             const cv::Range& rows, std::vector<float>& buf)
+{
+    T* dst = (T*)dstData;
+    const int width = g.dst.width;
+    const size_t plane = (size_t)g.dst.width * g.dst.height;
+    const int taps = TAPS ? TAPS : g.x.taps;
+    T pad[CN];
+    for (int ch = 0; ch < CN; ch++)
+        pad[ch] = cv::saturate_cast<T>(c.pad[ch]);
+    buf.resize((size_t)src.cols * CN);
+    float* b = buf.data();
+
+    for (int y = rows.start; y < rows.end; y++)
+    {
+        T* row = NCHW ? dst + (size_t)y * width : dst + (size_t)y * width * CN;
+        int x0 = g.roi.x, x1 = g.roi.x + g.roi.width;
+        if (y < g.roi.y || y >= g.roi.y + g.roi.height)
+            x0 = x1 = width;
+
+        for (int x = 0; x < x0; x++)
+            for (int ch = 0; ch < CN; ch++)
+                (NCHW ? row[ch * plane + x] : row[x * CN + ch]) = pad[ch];
+
+        if (x0 < x1)
+        {
+            const int* yi = &g.y.index[(size_t)(y - g.roi.y) * g.y.taps];
+            const float* yw = &g.y.weight[(size_t)(y - g.roi.y) * g.y.taps];
+            const uchar* r = src.ptr<uchar>(yi[0]);
+            for (int i = g.first; i < g.last; i++)
+                b[i] = r[i] * yw[0];
+            for (int k = 1; k < g.y.taps; k++)
+            {
+                if (yw[k] == 0)
+                    continue;
+                r = src.ptr<uchar>(yi[k]);
+                const float w = yw[k];
+                for (int i = g.first; i < g.last; i++)
+                    b[i] += r[i] * w;
+            }
+
+            const int* xi = &g.x.index[(size_t)(x0 - g.roi.x) * taps];
+            const float* xw = &g.x.weight[(size_t)(x0 - g.roi.x) * taps];
+            for (int x = x0; x < x1; x++, xi += taps, xw += taps)
+            {
+                float v[CN] = {};
+                for (int k = 0; k < taps; k++)
+                    for (int ch = 0; ch < CN; ch++)
+                        v[ch] += b[xi[k] + ch] * xw[k];
+                for (int ch = 0; ch < CN; ch++)
+                {
+                    T out = cv::saturate_cast<T>(v[c.order[ch]] * c.alpha[ch] + c.beta[ch]);
+                    (NCHW ? row[ch * plane + x] : row[x * CN + ch]) = out;
+                }
+            }
+        }
+
+        for (int x = x1; x < width; x++)
+            for (int ch = 0; ch < CN; ch++)
+                (NCHW ? row[ch * plane + x] : row[x * CN + ch]) = pad[ch];
+    }
+}
+
+typedef void (*RowsFn)(const Geometry&, const cv::Mat&, const Coefficients&, void*,
+                       const cv::Range&, std::vector<float>&);
+
+template<typename T, int CN>
+inline RowsFn selectRows(bool nchw, bool linear)
+{
+    if (nchw)
+        return linear ? &runRows<T, CN, true, 2> : &runRows<T, CN, true, 0>;
+    return linear ? &runRows<T, CN, false, 2> : &runRows<T, CN, false, 0>;
+}
+
+template<typename T>
+inline RowsFn selectRows(int cn, bool nchw, bool linear)
+{
+    return cn == 1 ? selectRows<T, 1>(nchw, linear) : selectRows<T, 3>(nchw, linear);
+}
+
+} // namespace preprocess
+
+// A PreprocessSpec compiled into a kernel specialised on the type, layout
+// and channels of the tensor: resize, crop or padding, channel order and
+// normalisation are done in one pass from the image to the tensor, with no
+// intermediate image. The resize is separable with the taps of cv::resize,
+// bilinear like cv::dnn::blobFromImage or INTER_AREA, in parallel over the
+// tensor rows.
+//
+// The tap tables are computed for one image size and kept until an image of
+// another size comes, a kernel is not meant to be shared between threads.
+class PreprocessKernel
+{
+public:
+    explicit PreprocessKernel(const PreprocessSpec& spec_ = PreprocessSpec()) : spec(spec_)
+    {
+        using namespace preprocess;
+        CV_Assert(spec.channels == 1 || spec.channels == 3);
+        CV_Assert(spec.interpolation == cv::INTER_LINEAR || spec.interpolation == cv::INTER_AREA);
+        const bool nchw = spec.layout == LAYOUT_NCHW;
+        if (spec.depth == CV_32F)
+        {
+            linear = selectRows<float>(spec.channels, nchw, true);
+            generic = selectRows<float>(spec.channels, nchw, false);
+        }
+        else if (spec.depth == CV_8U)
+        {
+            linear = selectRows<uchar>(spec.channels, nchw, true);
+            generic = selectRows<uchar>(spec.channels, nchw, false);
+        }
+        else
+            CV_Error(cv::Error::StsNotImplemented, "Only CV_32F and CV_8U tensors are supported");
+
+        for (int ch = 0; ch < spec.channels; ch++)
+        {
+            CV_Assert(spec.std[ch] != 0);
+            coeffs.alpha[ch] = (float)(spec.scale / spec.std[ch]);
+            coeffs.beta[ch] = (float)(-spec.mean[ch] * spec.scale / spec.std[ch]);
+            coeffs.pad[ch] = (float)((spec.padValue[ch] - spec.mean[ch]) * spec.scale / spec.std[ch]);
+            coeffs.order[ch] = spec.swapRB && spec.channels == 3 ? 2 - ch : ch;
+        }
+    }
+
+    const PreprocessSpec& preprocessSpec() const { return spec; }
+
+    // Tensor size of an image: the input size, or the image size.
+    cv::Size outputSize(const cv::Size& image) const
+    {
+        return spec.size.width > 0 && spec.size.height > 0 ? spec.size : image;
+    }
+
+    // Number of tensor elements of an image.
+    size_t elements(const cv::Size& image) const
+    {
+        return outputSize(image).area() * (size_t)spec.channels;
+    }
+
+    // One image into dst, elements(image.size()) values of the tensor depth.
+    void run(const cv::Mat& image, void* dst)
+    {
+        CV_Assert(!image.empty() && image.depth() == CV_8U && image.channels() == spec.channels);
+        TRACE_SCOPE("preprocess");
+        const preprocess::Geometry& g = geometryFor(image.size());
+        preprocess::RowsFn fn = g.x.taps == 2 ? linear : generic;
+        cv::parallel_for_(cv::Range(0, g.dst.height), [&](const cv::Range& r) {
+            std::vector<float> buf;
+            fn(g, image, coeffs, dst, r, buf);
+        });
+    }
+
+    // Images of the same tensor size into a 4D blob, N x C x H x W or
+    // N x H x W x C, only reallocated when its shape changes.
+    void run(const std::vector<cv::Mat>& images, cv::Mat& blob)
+    {
+        CV_Assert(!images.empty());
+        cv::Size out = outputSize(images[0].size());
+        int nchw[] = {(int)images.size(), spec.channels, out.height, out.width};
+        int nhwc[] = {(int)images.size(), out.height, out.width, spec.channels};
+        blob.create(4, spec.layout == LAYOUT_NCHW ? nchw : nhwc, spec.depth);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            CV_Assert(outputSize(images[i].size()) == out);
+            run(images[i], blob.ptr((int)i));
+        }
+    }
+
+    void run(const cv::Mat& image, cv::Mat& blob)
+    {
+        run(std::vector<cv::Mat>(1, image), blob);
+    }
+
+private:
+    const preprocess::Geometry& geometryFor(const cv::Size& src)
+    {
+        preprocess::Geometry& g = geometry;
+        if (g.src == src && !g.x.index.empty())
+            return g;
+
+        g.src = src;
+        g.dst = outputSize(src);
+        cv::Size resized = g.dst;
+        cv::Point offset;
+        g.roi = cv::Rect(cv::Point(), g.dst);
+        if (g.dst != src && spec.resize == RESIZE_CROP)
+        {
+            double f = spec.shortestEdge > 0 ? (double)spec.shortestEdge / std::min(src.width, src.height)
+                                             : std::max((double)g.dst.width / src.width, (double)g.dst.height / src.height);
+            resized = cv::Size(std::max(g.dst.width, cvRound(src.width * f)),
+                               std::max(g.dst.height, cvRound(src.height * f)));
+            offset = cv::Point((resized.width - g.dst.width) / 2, (resized.height - g.dst.height) / 2);
+        }
+        else if (g.dst != src && spec.resize == RESIZE_LETTERBOX)
+        {
+            double f = std::min((double)g.dst.width / src.width, (double)g.dst.height / src.height);
+            resized = cv::Size(std::min(g.dst.width, std::max(1, cvRound(src.width * f))),
+                               std::min(g.dst.height, std::max(1, cvRound(src.height * f))));
+            g.roi = cv::Rect((g.dst.width - resized.width) / 2, (g.dst.height - resized.height) / 2,
+                             resized.width, resized.height);
+        }
+
+        // like cv::resize, area boxes only when both axes are downscaled
+        preprocess::AxisMode mode = preprocess::AXIS_LINEAR;
+        if (spec.interpolation == cv::INTER_AREA)
+            mode = src.width >= resized.width && src.height >= resized.height ? preprocess::AXIS_AREA
+                                                                               : preprocess::AXIS_AREA_LINEAR;
+        preprocess::buildAxis(g.x, src.width, resized.width, offset.x, g.roi.width, mode);
+        preprocess::buildAxis(g.y, src.height, resized.height, offset.y, g.roi.height, mode);
+        // column taps in elements of the source row
+        for (size_t i = 0; i < g.x.index.size(); i++)
+            g.x.index[i] *= spec.channels;
+        g.first = *std::min_element(g.x.index.begin(), g.x.index.end());
+        g.last = *std::max_element(g.x.index.begin(), g.x.index.end()) + spec.channels;
+        return g;
+    }
+
+    PreprocessSpec spec;
+    preprocess::RowsFn linear, generic;
+    preprocess::Coefficients coeffs;
+    preprocess::Geometry geometry;
+};
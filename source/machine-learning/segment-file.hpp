@@ -0,0 +1,152 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Compact binary storage of line segments for many images.
+//
+//   header   | SegmentFileHeader, 64 bytes
+//   records  | segmentCount x float4 (x1, y1, x2, y2), all images back to back
+//   offsets  | (imageCount + 1) x uint64, first record of each image
+//
+// The segments of image i are records [offsets[i], offsets[i+1]). Records are
+// streamed while images are processed, the offsets table is written last, so
+// the writer only keeps 8 bytes per image in memory.
+struct SegmentFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t imageCount;
+    uint64_t segmentCount;
+    uint64_t recordsOffset;
+    uint64_t offsetsOffset;
+    uint32_t pyramidLevels;  // detection ran on images downsampled 2^levels times
+    uint32_t reserved[5];
+};
+static_assert(sizeof(SegmentFileHeader) == 64, "SegmentFileHeader must stay 64 bytes");
+
+static const char kSegmentFileMagic[4] = {'L', 'S', 'D', 'B'};
+static const uint32_t kSegmentFileVersion = 1;
+
+class SegmentFileWriter
+{
+public:
+    explicit SegmentFileWriter(const std::string& path, uint32_t pyramidLevels = 0)
+        : file(fopen(path.c_str(), "wb"))
+    {
+        if (!file)
+            CV_Error(cv::Error::StsError, "Can not open " + path + " for writing");
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kSegmentFileMagic, sizeof(header.magic));
+        header.version = kSegmentFileVersion;
+        header.recordsOffset = sizeof(header);
+        header.pyramidLevels = pyramidLevels;
+        // placeholder, rewritten by close()
+        if (fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            fclose(file);
+            CV_Error(cv::Error::StsError, "Failed to write the header of " + path);
+        }
+        offsets.push_back(0);
+    }
+
+    // Closes the file if close() was not called, a failure is then ignored.
+    ~SegmentFileWriter() { close(); }
+
+    SegmentFileWriter(const SegmentFileWriter&) = delete;
+    SegmentFileWriter& operator=(const SegmentFileWriter&) = delete;
+
+    void append(const std::vector<cv::Vec4f>& segments)
+    {
+        static_assert(sizeof(cv::Vec4f) == 4 * sizeof(float), "Vec4f must be packed");
+        if (!segments.empty() && fwrite(segments.data(), sizeof(cv::Vec4f), segments.size(), file) != segments.size())
+            CV_Error(cv::Error::StsError, "Failed to write segments");
+        header.segmentCount += segments.size();
+        offsets.push_back(header.segmentCount);
+    }
+
+    // Writes the offsets table and the final header. Returns false when any
+    // of it, or the data still buffered, could not be written: the file is
+    // then incomplete. The file is closed either way.
+    bool close()
+    {
+        if (!file)
+            return true;
+        header.imageCount = offsets.size() - 1;
+        header.offsetsOffset = header.recordsOffset + header.segmentCount * sizeof(cv::Vec4f);
+        bool ok = fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size() &&
+                  fseek(file, 0, SEEK_SET) == 0 &&
+                  fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        file = NULL;
+        return ok;
+    }
+
+private:
+    FILE* file;
+    SegmentFileHeader header;
+    std::vector<uint64_t> offsets;
+};
+
+// Read-only memory mapping of a segment file, nothing is copied.
+class SegmentFileReader
+{
+public:
+    explicit SegmentFileReader(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            CV_Error(cv::Error::StsError, "Can not open " + path);
+        struct stat st;
+        fstat(fd, &st);
+        size = (size_t)st.st_size;
+        base = size >= sizeof(SegmentFileHeader) ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED)
+            CV_Error(cv::Error::StsError, "Can not map " + path);
+
+        header = (const SegmentFileHeader*)base;
+        if (memcmp(header->magic, kSegmentFileMagic, sizeof(header->magic)) != 0 ||
+            header->version != kSegmentFileVersion ||
+            header->offsetsOffset + (header->imageCount + 1) * sizeof(uint64_t) > size)
+        {
+            munmap(base, size);
+            CV_Error(cv::Error::StsError, path + " is not a valid segment file");
+        }
+        records = (const cv::Vec4f*)((const char*)base + header->recordsOffset);
+        offsets = (const uint64_t*)((const char*)base + header->offsetsOffset);
+    }
+
+    ~SegmentFileReader() { munmap(base, size); }
+
+    SegmentFileReader(const SegmentFileReader&) = delete;
+    SegmentFileReader& operator=(const SegmentFileReader&) = delete;
+
+    size_t images() const { return (size_t)header->imageCount; }
+    int pyramidLevels() const { return (int)header->pyramidLevels; }
+
+    // Segments of image i, valid as long as the reader is alive.
+    const cv::Vec4f* segments(size_t i, size_t& count) const
+    {
+        CV_Assert(i < images());
+        count = (size_t)(offsets[i + 1] - offsets[i]);
+        return records + offsets[i];
+    }
+
+private:
+    void* base;
+    size_t size;
+    const SegmentFileHeader* header;
+    const cv::Vec4f* records;
+    const uint64_t* offsets;
+};
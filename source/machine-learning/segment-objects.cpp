@@ -4,6 +4,12 @@
 #include "opencv2/video/background_segm.hpp"
 #include <stdio.h>
 #include <string>
+
+#include "segment-refine.hpp"
+#include "bgs-downscale.hpp"
+#include "frame-source.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
  
 using namespace std;
 using namespace cv;
@@ -18,58 +24,30 @@ static void help(char** argv)
             "%s [video file, else it reads camera 0]\n\n", argv[0]);
 }
  
-static void refineSegments(const Mat& img, Mat& mask, Mat& dst)
-{
-    int niters = 3;
- 
-    vector<vector<Point> > contours;
-    vector<Vec4i> hierarchy;
- 
-    Mat temp;
- 
-    dilate(mask, temp, Mat(), Point(-1,-1), niters);
-    erode(temp, temp, Mat(), Point(-1,-1), niters*2);
-    dilate(temp, temp, Mat(), Point(-1,-1), niters);
- 
-    findContours( temp, contours, hierarchy, RETR_CCOMP, CHAIN_APPROX_SIMPLE );
- 
-    dst = Mat::zeros(img.size(), CV_8UC3);
- 
-    if( contours.size() == 0 )
-        return;
- 
-    // iterate through all the top-level contours,
-    // draw each connected component with its own random color
-    int idx = 0, largestComp = 0;
-    double maxArea = 0;
- 
-    for( ; idx >= 0; idx = hierarchy[idx][0] )
-    {
-        const vector<Point>& c = contours[idx];
-        double area = fabs(contourArea(Mat(c)));
-        if( area > maxArea )
-        {
-            maxArea = area;
-            largestComp = idx;
-        }
-    }
-    Scalar color( 0, 0, 255 );
-    drawContours( dst, contours, largestComp, color, FILLED, LINE_8, hierarchy );
-}
- 
- 
 int main(int argc, char** argv)
 {
     VideoCapture cap;
     bool update_bg_model = true;
  
-    CommandLineParser parser(argc, argv, "{help h||}{@input||}");
+    CommandLineParser parser(argc, argv, "{help h||}{@input||}{legacy||use the contour based clean up}"
+                                         "{downscale|1|run the model on frames downsampled by this factor, e.g. 2 or 4}"
+                                         "{norefine||do not refine the upsampled mask borders at full resolution}"
+                                         TRACE_KEYS METRICS_KEYS);
     if (parser.has("help"))
     {
         help(argv);
         return 0;
     }
     string input = parser.get<std::string>("@input");
+    bool legacy = parser.has("legacy");
+    ScaledBackgroundSubtractor::Params scaled;
+    scaled.factor = max(1, parser.get<int>("downscale"));
+    scaled.refine = !parser.has("norefine");
+    trace::Session tracing(parser);
+    metrics::Reporter reporter(parser);
+    metrics::Histogram& bgsTime = metrics::histogram("segment_objects.bgs");
+    metrics::Histogram& refineTime = metrics::histogram("segment_objects.refine");
+    metrics::Counter& frames = metrics::counter("segment_objects.frames");
     if (input.empty())
         cap.open(0);
     else
@@ -82,6 +60,8 @@ int main(int argc, char** argv)
     }
  
     Mat tmp_frame, bgmask, out_frame;
+    RefineBuffers buffers;
+    vector<SegmentComponent> components;
  
     cap >> tmp_frame;
     if(tmp_frame.empty())
@@ -95,15 +75,38 @@ int main(int argc, char** argv)
  
     Ptr<BackgroundSubtractorMOG2> bgsubtractor=createBackgroundSubtractorMOG2();
     bgsubtractor->setVarThreshold(10);
+    ScaledBackgroundSubtractor scaledsubtractor(bgsubtractor, scaled);
  
-    for(;;)
+    // live cameras drop stale frames, files are processed entirely
+    FrameSource source([&cap](Mat& m) { return cap.read(m); }, 4,
+                       input.empty() ? FrameSource::DropOldest : FrameSource::Block);
+    FrameSource::Frame grabbed;
+    while( source.read(grabbed) )
     {
-        cap >> tmp_frame;
-        if( tmp_frame.empty() )
-            break;
-        bgsubtractor->apply(tmp_frame, bgmask, update_bg_model ? -1 : 0);
-        refineSegments(tmp_frame, bgmask, out_frame);
-        imshow("video", tmp_frame);
+        // only valid while grabbed holds it
+        const Mat& frame = grabbed.image;
+        trace::FrameScope traced(grabbed.index);
+        {
+            TRACE_SCOPE("bgs.apply");
+            metrics::ScopedTimer timer(bgsTime);
+            scaledsubtractor.apply(frame, bgmask, update_bg_model ? -1 : 0);
+        }
+        {
+            TRACE_SCOPE("refine");
+            metrics::ScopedTimer timer(refineTime);
+            if (legacy)
+                refineSegments(frame, bgmask, out_frame);
+            else
+            {
+                int largest = refineSegmentsFast(bgmask, buffers, components);
+                out_frame.create(frame.size(), CV_8UC3);
+                out_frame.setTo(Scalar::all(0));
+                if (largest >= 0)
+                    drawSegment(buffers, components[largest], out_frame, Scalar(0, 0, 255));
+            }
+        }
+        frames.add();
+        imshow("video", frame);
         imshow("segmented", out_frame);
         char keycode = (char)waitKey(30);
         if( keycode == 27 )
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <vector>
+
+// Clean up of a background subtraction mask, keeping its largest connected
+// component drawn in red into a new 3-channel image. Contour based reference
+// implementation, see refineSegmentsFast for the one used by the pipelines.
+inline void refineSegments(const cv::Mat& img, cv::Mat& mask, cv::Mat& dst)
+{
+    int niters = 3;
+
+    std::vector<std::vector<cv::Point> > contours;
+    std::vector<cv::Vec4i> hierarchy;
+
+    cv::Mat temp;
+
+    cv::dilate(mask, temp, cv::Mat(), cv::Point(-1,-1), niters);
+    cv::erode(temp, temp, cv::Mat(), cv::Point(-1,-1), niters*2);
+    cv::dilate(temp, temp, cv::Mat(), cv::Point(-1,-1), niters);
+
+    cv::findContours( temp, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE );
+
+    dst = cv::Mat::zeros(img.size(), CV_8UC3);
+
+    if( contours.size() == 0 )
+        return;
+
+    // iterate through all the top-level contours,
+    // draw each connected component with its own random color
+    int idx = 0, largestComp = 0;
+    double maxArea = 0;
+
+    for( ; idx >= 0; idx = hierarchy[idx][0] )
+    {
+        const std::vector<cv::Point>& c = contours[idx];
+        double area = std::fabs(cv::contourArea(cv::Mat(c)));
+        if( area > maxArea )
+        {
+            maxArea = area;
+            largestComp = idx;
+        }
+    }
+    cv::Scalar color( 0, 0, 255 );
+    cv::drawContours( dst, contours, largestComp, color, cv::FILLED, cv::LINE_8, hierarchy );
+}
+
+struct SegmentComponent
+{
+    int label;          // value of the component in RefineBuffers::labels
+    int area;           // in pixels
+    cv::Rect box;
+    cv::Point2d centroid;
+};
+
+// Buffers kept between frames so the refinement does not allocate once the
+// frame size is stable.
+struct RefineBuffers
+{
+    cv::Mat temp, labels, stats, centroids;
+};
+
+// Same clean up as refineSegments, without contours: one close and one open
+// (dilate n, erode 2n, dilate n) into a reused buffer, then the parallel
+// connected components labelling gives the areas directly. All the components
+// are returned, the index of the largest one is returned (-1 if none).
+// Unlike the contour version, holes inside a component are not filled.
+inline int refineSegmentsFast(const cv::Mat& mask, RefineBuffers& buf,
+                              std::vector<SegmentComponent>& components, int niters = 3)
+{
+    cv::morphologyEx(mask, buf.temp, cv::MORPH_CLOSE, cv::Mat(), cv::Point(-1,-1), niters);
+    cv::morphologyEx(buf.temp, buf.temp, cv::MORPH_OPEN, cv::Mat(), cv::Point(-1,-1), niters);
+
+    int n = cv::connectedComponentsWithStats(buf.temp, buf.labels, buf.stats, buf.centroids,
+                                             8, CV_32S, cv::CCL_DEFAULT);
+
+    components.clear();
+    int largest = -1;
+    for (int i = 1; i < n; i++)
+    {
+        const int* st = buf.stats.ptr<int>(i);
+        SegmentComponent c;
+        c.label = i;
+        c.area = st[cv::CC_STAT_AREA];
+        c.box = cv::Rect(st[cv::CC_STAT_LEFT], st[cv::CC_STAT_TOP], st[cv::CC_STAT_WIDTH], st[cv::CC_STAT_HEIGHT]);
+        c.centroid = cv::Point2d(buf.centroids.at<double>(i, 0), buf.centroids.at<double>(i, 1));
+        if (largest < 0 || c.area > components[largest].area)
+            largest = (int)components.size();
+        components.push_back(c);
+    }
+    return largest;
+}
+
+// Paint one component of the last refineSegmentsFast call, only inside its
+// bounding box. Meant for display, the pipelines use the component list.
+inline void drawSegment(const RefineBuffers& buf, const SegmentComponent& c, cv::Mat& dst, const cv::Scalar& color)
+{
+    cv::Mat roi = dst(c.box);
+    cv::Mat inside = buf.labels(c.box) == c.label;
+    roi.setTo(color, inside);
+}
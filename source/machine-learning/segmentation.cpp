@@ -6,12 +6,18 @@
 #include <opencv2/highgui.hpp>
  
 #include "common.hpp"
+#include "batch-infer.hpp"
+#include "frame-source.hpp"
+#include "colorize-segmentation.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
  
 std::string keys =
     "{ help  h     | | Print help message. }"
     "{ @alias      | | An alias name of model to extract preprocessing parameters from models.yml file. }"
     "{ zoo         | models.yml | An optional path to file with preprocessing parameters }"
     "{ device      |  0 | camera device number. }"
+    "{ batch       |  1 | Number of frames to run through the network in one forward pass. }"
     "{ input i     | | Path to input image or video file. Skip this argument to capture frames from a camera. }"
     "{ framework f | | Optional name of an origin framework of the model. Detect it automatically if it does not set. }"
     "{ classes     | | Optional path to a text file with names of classes. }"
@@ -31,7 +37,9 @@ std::string keys =
                         "3: VPU, "
                         "4: Vulkan, "
                         "6: CUDA, "
-                        "7: CUDA fp16 (half-float preprocess) }";
+                        "7: CUDA fp16 (half-float preprocess) }"
+    METRICS_KEYS
+    TRACE_KEYS;
  
 using namespace cv;
 using namespace dnn;
@@ -41,8 +49,6 @@ std::vector<Vec3b> colors;
  
 void showLegend();
  
-void colorizeSegmentation(const Mat &score, Mat &segm);
- 
 int main(int argc, char** argv)
 {
     CommandLineParser parser(argc, argv, keys);
@@ -60,13 +66,10 @@ int main(int argc, char** argv)
         return 0;
     }
  
-    float scale = parser.get<float>("scale");
-    Scalar mean = parser.get<Scalar>("mean");
-    bool swapRB = parser.get<bool>("rgb");
-    int inpWidth = parser.get<int>("width");
-    int inpHeight = parser.get<int>("height");
-    String model = findFile(parser.get<String>("model"));
-    String config = findFile(parser.get<String>("config"));
+    // zoo defaults, parsed once, with the command line overrides
+    ModelSpec spec = parsePreprocArguments(parser, modelName);
+    String model = findFile(spec.model);
+    String config = findFile(spec.config);
     String framework = parser.get<String>("framework");
     int backendId = parser.get<int>("backend");
     int targetId = parser.get<int>("target");
@@ -125,96 +128,74 @@ int main(int argc, char** argv)
     else
         cap.open(parser.get<int>("device"));
  
-    // Process frames.
-    Mat frame, blob;
-    while (waitKey(1) < 0)
+    metrics::Reporter reporter(parser);
+    trace::Session tracing(parser);
+    metrics::Histogram& forwardTime = metrics::histogram("segmentation.forward");
+    metrics::Histogram& frameTime = metrics::histogram("segmentation.frame_inference");
+    metrics::Histogram& postTime = metrics::histogram("segmentation.postprocess");
+    metrics::Counter& frameCount = metrics::counter("segmentation.frames");
+
+    // Process frames, a batch of them per forward pass.
+    BatchedForward batched(net, spec.preprocess());
+    const int batch = std::max(1, parser.get<int>("batch"));
+    // a whole batch is held while the next one is decoded
+    FrameSource source([&cap](Mat& m) { return cap.read(m); }, 2 * batch + 1,
+                       parser.has("input") ? FrameSource::Block : FrameSource::DropOldest);
+    std::vector<FrameSource::Frame> frames(batch);
+    std::vector<Mat> inputs;
+    bool finished = false;
+    while (!finished && waitKey(1) < 0)
     {
-        cap >> frame;
-        if (frame.empty())
+        inputs.clear();
+        for (size_t i = 0; i < frames.size(); i++)
         {
-            waitKey();
-            break;
+            if (!source.read(frames[i]))
+            {
+                finished = true;
+                break;
+            }
+            inputs.push_back(frames[i].image);
         }
+        if (inputs.empty())
+            break;
  
-        blobFromImage(frame, blob, scale, Size(inpWidth, inpHeight), mean, swapRB, false);
- 
-        net.setInput(blob);
-        Mat score = net.forward();
- 
-        Mat segm;
-        colorizeSegmentation(score, segm);
- 
-        resize(segm, segm, frame.size(), 0, 0, INTER_NEAREST);
-        addWeighted(frame, 0.1, segm, 0.9, 0.0, frame);
+        // a batch is traced under its first frame
+        metrics::ScopedTimer timer(forwardTime);
+        trace::FrameScope tracedBatch(frames[0].index);
+        const std::vector<Mat>& scores = batched.forward(inputs);
  
-        // Put efficiency information.
-        std::vector<double> layersTimes;
-        double freq = getTickFrequency() / 1000;
-        double t = net.getPerfProfile(layersTimes) / freq;
+        // Put efficiency information, amortised over the batch.
+        double t = timer.stop() / inputs.size();
+        frameTime.record(t / 1000);
+        frameCount.add(inputs.size());
         std::string label = format("Inference time: %.2f ms", t);
-        putText(frame, label, Point(0, 15), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0));
  
-        imshow(kWinName, frame);
-        if (!classes.empty())
-            showLegend();
-    }
-    return 0;
-}
- 
-void colorizeSegmentation(const Mat &score, Mat &segm)
-{
-    const int rows = score.size[2];
-    const int cols = score.size[3];
-    const int chns = score.size[1];
- 
-    if (colors.empty())
-    {
-        // Generate colors.
-        colors.push_back(Vec3b());
-        for (int i = 1; i < chns; ++i)
+        for (size_t i = 0; i < inputs.size(); i++)
         {
-            Vec3b color;
-            for (int j = 0; j < 3; ++j)
-                color[j] = (colors[i - 1][j] + rand() % 256) / 2;
-            colors.push_back(color);
-        }
-    }
-    else if (chns != (int)colors.size())
-    {
-        CV_Error(Error::StsError, format("Number of output classes does not match "
-                                         "number of colors (%d != %zu)", chns, colors.size()));
-    }
- 
-    Mat maxCl = Mat::zeros(rows, cols, CV_8UC1);
-    Mat maxVal(rows, cols, CV_32FC1, score.data);
-    for (int ch = 1; ch < chns; ch++)
-    {
-        for (int row = 0; row < rows; row++)
-        {
-            const float *ptrScore = score.ptr<float>(0, ch, row);
-            uint8_t *ptrMaxCl = maxCl.ptr<uint8_t>(row);
-            float *ptrMaxVal = maxVal.ptr<float>(row);
-            for (int col = 0; col < cols; col++)
+            Mat& frame = inputs[i];
+            Mat segm;
+            trace::FrameScope traced(frames[i].index);
             {
-                if (ptrScore[col] > ptrMaxVal[col])
-                {
-                    ptrMaxVal[col] = ptrScore[col];
-                    ptrMaxCl[col] = (uchar)ch;
-                }
+                metrics::ScopedTimer post(postTime);
+                TRACE_SCOPE("postprocess");
+                colorizeSegmentation(scores[i], segm, colors);
+ 
+                resize(segm, segm, frame.size(), 0, 0, INTER_NEAREST);
+                addWeighted(frame, 0.1, segm, 0.9, 0.0, frame);
             }
-        }
-    }
  
-    segm.create(rows, cols, CV_8UC3);
-    for (int row = 0; row < rows; row++)
-    {
-        const uchar *ptrMaxCl = maxCl.ptr<uchar>(row);
-        Vec3b *ptrSegm = segm.ptr<Vec3b>(row);
-        for (int col = 0; col < cols; col++)
-        {
-            ptrSegm[col] = colors[ptrMaxCl[col]];
+            putText(frame, label, Point(0, 15), FONT_HERSHEY_SIMPLEX, 0.5, Scalar(0, 255, 0));
+ 
+            imshow(kWinName, frame);
+            if (!classes.empty())
+                showLegend();
+            if (i + 1 < inputs.size())
+                waitKey(1);
         }
     }
+    if (finished)
+        waitKey();
+    return 0;
 }
  
 void showLegend()
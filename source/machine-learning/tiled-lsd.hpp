@@ -0,0 +1,237 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.hpp"
+
+// Line segment detection on very large images. The image is split into
+// overlapping tiles which are processed in parallel, each one with its own
+// detector. Duplicates coming from the overlaps are dropped and the pieces of
+// segments that were cut by a tile border are merged back together.
+struct TiledLsdParams
+{
+    int tileSize = 1024;        // size of the tile core, in pixels
+    int overlap = 32;           // extra margin around each core on every side
+    int refine = cv::LSD_REFINE_NONE;
+    float mergeDistance = 1.5f; // max distance of an endpoint to the other segment's line
+    float mergeGap = 4.f;       // max gap between two collinear pieces
+    float mergeAngle = 2.f;     // max angle between two pieces, in degrees
+};
+
+namespace tiled_lsd
+{
+
+struct Tile
+{
+    cv::Rect core, roi;
+};
+
+inline std::vector<Tile> makeTiles(cv::Size size, int tileSize, int overlap)
+{
+    std::vector<Tile> tiles;
+    cv::Rect image(0, 0, size.width, size.height);
+    for (int y = 0; y < size.height; y += tileSize)
+    {
+        for (int x = 0; x < size.width; x += tileSize)
+        {
+            Tile t;
+            t.core = cv::Rect(x, y, tileSize, tileSize) & image;
+            t.roi = cv::Rect(x - overlap, y - overlap, tileSize + 2 * overlap, tileSize + 2 * overlap) & image;
+            tiles.push_back(t);
+        }
+    }
+    return tiles;
+}
+
+inline float length(const cv::Vec4f& l)
+{
+    return std::hypot(l[2] - l[0], l[3] - l[1]);
+}
+
+// True when b continues a, i.e. both are nearly parallel with the same
+// polarity, b lies on the line of a and the gap between them is small.
+inline bool collinear(const cv::Vec4f& a, const cv::Vec4f& b, float maxDist, float maxGap, float cosAngle)
+{
+    float la = length(a), lb = length(b);
+    if (la < 1e-3f || lb < 1e-3f)
+        return false;
+    float ux = (a[2] - a[0]) / la, uy = (a[3] - a[1]) / la;
+    float vx = (b[2] - b[0]) / lb, vy = (b[3] - b[1]) / lb;
+    if (ux * vx + uy * vy < cosAngle)
+        return false;
+
+    // perpendicular distance of the endpoints of b to the line of a
+    float d0 = (b[0] - a[0]) * uy - (b[1] - a[1]) * ux;
+    float d1 = (b[2] - a[0]) * uy - (b[3] - a[1]) * ux;
+    if (std::abs(d0) > maxDist || std::abs(d1) > maxDist)
+        return false;
+
+    // projections of b on a, [0, la] is the extent of a
+    float t0 = (b[0] - a[0]) * ux + (b[1] - a[1]) * uy;
+    float t1 = (b[2] - a[0]) * ux + (b[3] - a[1]) * uy;
+    return std::max(t0, t1) >= -maxGap && std::min(t0, t1) <= la + maxGap;
+}
+
+inline int findRoot(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+// Merge groups of collinear segments among the candidates. Segments are
+// bucketed by the grid cells of their endpoints so only neighbours are tested.
+inline void mergeCollinear(std::vector<cv::Vec4f>& segs, const TiledLsdParams& params)
+{
+    const int n = (int)segs.size();
+    if (n < 2)
+        return;
+    const float cosAngle = (float)std::cos(params.mergeAngle * CV_PI / 180);
+    // pieces cut by a border overlap by up to twice the tile overlap
+    const float cell = std::max(8.f, 2 * (params.overlap + params.mergeGap));
+
+    auto key = [cell](float x, float y) {
+        return ((uint64_t)(uint32_t)(int)std::floor(x / cell) << 32) | (uint32_t)(int)std::floor(y / cell);
+    };
+    std::unordered_map<uint64_t, std::vector<int> > grid;
+    for (int i = 0; i < n; i++)
+    {
+        grid[key(segs[i][0], segs[i][1])].push_back(i);
+        grid[key(segs[i][2], segs[i][3])].push_back(i);
+    }
+
+    std::vector<int> parent(n);
+    for (int i = 0; i < n; i++)
+        parent[i] = i;
+    for (int i = 0; i < n; i++)
+    {
+        for (int e = 0; e < 4; e += 2)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    auto it = grid.find(key(segs[i][e] + dx * cell, segs[i][e + 1] + dy * cell));
+                    if (it == grid.end())
+                        continue;
+                    for (int j : it->second)
+                    {
+                        if (j <= i || findRoot(parent, i) == findRoot(parent, j))
+                            continue;
+                        const cv::Vec4f& a = length(segs[i]) >= length(segs[j]) ? segs[i] : segs[j];
+                        const cv::Vec4f& b = &a == &segs[i] ? segs[j] : segs[i];
+                        if (collinear(a, b, params.mergeDistance, params.mergeGap, cosAngle))
+                            parent[findRoot(parent, j)] = findRoot(parent, i);
+                    }
+                }
+            }
+        }
+    }
+
+    // each group becomes one segment along the line of its longest member,
+    // spanning the extreme projections of all the endpoints
+    std::vector<int> longest(n, -1);
+    for (int i = 0; i < n; i++)
+    {
+        int r = findRoot(parent, i);
+        if (longest[r] < 0 || length(segs[i]) > length(segs[longest[r]]))
+            longest[r] = i;
+    }
+    std::vector<float> tmin(n, 0.f), tmax(n, 0.f);
+    std::vector<bool> seen(n, false);
+    for (int i = 0; i < n; i++)
+    {
+        int r = findRoot(parent, i);
+        const cv::Vec4f& a = segs[longest[r]];
+        float la = length(a);
+        float ux = (a[2] - a[0]) / la, uy = (a[3] - a[1]) / la;
+        for (int e = 0; e < 4; e += 2)
+        {
+            float t = (segs[i][e] - a[0]) * ux + (segs[i][e + 1] - a[1]) * uy;
+            tmin[r] = seen[r] ? std::min(tmin[r], t) : t;
+            tmax[r] = seen[r] ? std::max(tmax[r], t) : t;
+            seen[r] = true;
+        }
+    }
+    std::vector<cv::Vec4f> merged;
+    merged.reserve(n);
+    for (int r = 0; r < n; r++)
+    {
+        if (parent[r] != r)
+            continue;
+        const cv::Vec4f& a = segs[longest[r]];
+        float la = length(a);
+        float ux = la > 0 ? (a[2] - a[0]) / la : 0.f, uy = la > 0 ? (a[3] - a[1]) / la : 0.f;
+        merged.push_back(cv::Vec4f(a[0] + tmin[r] * ux, a[1] + tmin[r] * uy,
+                                   a[0] + tmax[r] * ux, a[1] + tmax[r] * uy));
+    }
+    segs.swap(merged);
+}
+
+} // namespace tiled_lsd
+
+inline void detectLinesTiled(const cv::Mat& gray, std::vector<cv::Vec4f>& lines,
+                             const TiledLsdParams& params = TiledLsdParams())
+{
+    CV_Assert(gray.type() == CV_8UC1);
+    CV_Assert(params.tileSize > 0 && params.overlap >= 0);
+
+    std::vector<tiled_lsd::Tile> tiles = tiled_lsd::makeTiles(gray.size(), params.tileSize, params.overlap);
+    std::vector<std::vector<cv::Vec4f> > found(tiles.size());
+
+    // the workers trace their tiles under the frame of the caller
+    const int64_t frame = trace::currentFrame();
+    cv::parallel_for_(cv::Range(0, (int)tiles.size()), [&](const cv::Range& range) {
+        // the detector keeps per-image state, one per worker
+        cv::Ptr<cv::LineSegmentDetector> lsd = cv::createLineSegmentDetector(params.refine);
+        std::vector<cv::Vec4f> local;
+        for (int i = range.start; i < range.end; i++)
+        {
+            const tiled_lsd::Tile& t = tiles[i];
+            local.clear();
+            trace::Span span("lsd.tile", frame);
+            lsd->detect(gray(t.roi), local);
+            span.end();
+            for (size_t k = 0; k < local.size(); k++)
+            {
+                cv::Vec4f l = local[k] + cv::Vec4f((float)t.roi.x, (float)t.roi.y, (float)t.roi.x, (float)t.roi.y);
+                // a segment seen by several tiles is kept by the one owning its midpoint
+                cv::Point2f mid((l[0] + l[2]) / 2, (l[1] + l[3]) / 2);
+                if (mid.x >= t.core.x && mid.x < t.core.br().x && mid.y >= t.core.y && mid.y < t.core.br().y)
+                    found[i].push_back(l);
+            }
+        }
+    });
+
+    // only segments ending near an inner tile border can have been cut
+    lines.clear();
+    std::vector<cv::Vec4f> border;
+    const float margin = params.overlap + params.mergeGap;
+    auto nearBorder = [&](float v, int extent) {
+        float r = std::fmod(v, (float)params.tileSize);
+        return v > margin && v < extent - margin && (r < margin || r > params.tileSize - margin);
+    };
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        for (size_t k = 0; k < found[i].size(); k++)
+        {
+            const cv::Vec4f& l = found[i][k];
+            bool cut = false;
+            for (int e = 0; e < 4 && !cut; e += 2)
+                cut = nearBorder(l[e], gray.cols) || nearBorder(l[e + 1], gray.rows);
+            (cut ? border : lines).push_back(l);
+        }
+    }
+    {
+        TRACE_SCOPE("lsd.merge");
+        tiled_lsd::mergeCollinear(border, params);
+    }
+    lines.insert(lines.end(), border.begin(), border.end());
+}
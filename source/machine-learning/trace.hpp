@@ -0,0 +1,347 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "metrics.hpp"
+
+// Options of trace::Session, to append to the keys of a CommandLineParser.
+#define TRACE_KEYS \
+    "{ trace        |       | write a Chrome trace of the stages to this file on exit, SIGINT or SIGTERM }" \
+    "{ trace-events | 65536 | trace: events kept per thread, the oldest are overwritten }"
+
+// Span named `name` (a string literal) until the end of the scope.
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+// Opt-in recorder of the stages of a pipeline, written in the Chrome trace
+// event format (chrome://tracing, ui.perfetto.dev).
+//
+// Each thread appends to its own ring of events, without a lock, the oldest
+// events being overwritten once the ring is full, so a long run keeps its
+// last seconds. A span stores its name, the frame it worked on and its begin
+// and end time stamps, taken with metrics::ticks(). Spans inherit the frame
+// of the innermost FrameScope of their thread, which is how the stages of
+// the batch and network helpers get the frame ID of the demo loop calling
+// them. When no Session is active a span only reads one flag.
+namespace trace {
+
+struct Event
+{
+    const char* name;
+    int64_t frame;                  // -1 when not working on a frame
+    uint64_t begin, end;            // metrics::ticks()
+};
+
+// Written by its thread only, read by Session when writing the file.
+struct Ring
+{
+    Ring(size_t capacity, int tid_) : events(capacity), head(0), tid(tid_) {}
+
+    std::vector<Event> events;      // power of two
+    std::atomic<uint64_t> head;     // events ever written
+    int tid;
+    std::string threadName;
+};
+
+struct State
+{
+    std::atomic<bool> enabled{false};
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Ring> > rings;
+    std::set<std::string> names;
+    size_t capacity = 1 << 16;
+    uint64_t origin = 0;
+
+    static State& instance()
+    {
+        static State state;
+        return state;
+    }
+};
+
+inline bool enabled()
+{
+    return State::instance().enabled.load(std::memory_order_relaxed);
+}
+
+inline std::string& localThreadName()
+{
+    static thread_local std::string name;
+    return name;
+}
+
+// Ring of the calling thread, created by its first event.
+inline Ring& localRing()
+{
+    static thread_local Ring* ring = NULL;
+    if (!ring)
+    {
+        State& s = State::instance();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.rings.emplace_back(new Ring(s.capacity, (int)s.rings.size() + 1));
+        ring = s.rings.back().get();
+        ring->threadName = localThreadName();
+    }
+    return *ring;
+}
+
+inline int64_t& currentFrame()
+{
+    static thread_local int64_t frame = -1;
+    return frame;
+}
+
+// Name shown for the calling thread, may be set before a Session starts.
+inline void setThreadName(const std::string& name)
+{
+    localThreadName() = name;
+    if (enabled())
+    {
+        Ring& ring = localRing();
+        std::lock_guard<std::mutex> lock(State::instance().mutex);
+        ring.threadName = name;
+    }
+}
+
+// Stable copy of a runtime name, for spans named after e.g. graph nodes.
+inline const char* intern(const std::string& name)
+{
+    State& s = State::instance();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.names.insert(name).first->c_str();
+}
+
+inline void record(const char* name, int64_t frame, uint64_t begin, uint64_t end)
+{
+    Ring& ring = localRing();
+    uint64_t h = ring.head.load(std::memory_order_relaxed);
+    Event& e = ring.events[h & (ring.events.size() - 1)];
+    e.name = name;
+    e.frame = frame;
+    e.begin = begin;
+    e.end = end;
+    ring.head.store(h + 1, std::memory_order_release);
+}
+
+// Begin and end of a stage, recorded as one complete event when it ends.
+class Span
+{
+public:
+    explicit Span(const char* name_)
+        : name(enabled() ? name_ : NULL), frame(currentFrame()), begin(name ? metrics::ticks() : 0) {}
+    Span(const char* name_, int64_t frame_)
+        : name(enabled() ? name_ : NULL), frame(frame_), begin(name ? metrics::ticks() : 0) {}
+    ~Span() { end(); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    // For stages that learn their frame while running, e.g. a decoder.
+    void setFrame(int64_t frame_) { frame = frame_; }
+
+    void end()
+    {
+        if (!name)
+            return;
+        record(name, frame, begin, metrics::ticks());
+        name = NULL;
+    }
+
+private:
+    const char* name;
+    int64_t frame;
+    uint64_t begin;
+};
+
+// Frame ID of the spans of the calling thread until the end of the scope.
+class FrameScope
+{
+public:
+    explicit FrameScope(int64_t frame) : previous(currentFrame()) { currentFrame() = frame; }
+    ~FrameScope() { currentFrame() = previous; }
+
+    FrameScope(const FrameScope&) = delete;
+    FrameScope& operator=(const FrameScope&) = delete;
+
+private:
+    int64_t previous;
+};
+
+// The events of all the threads in the Chrome trace JSON format, times in
+// microseconds since the start of the session. Threads may keep recording:
+// events overwritten while they were copied are left out.
+inline std::string toJson()
+{
+    State& s = State::instance();
+    const double usPerTick = metrics::secondsPerTick() * 1e6;
+    std::string r = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    char buf[512];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (size_t i = 0; i < s.rings.size(); i++)
+    {
+        Ring& ring = *s.rings[i];
+        const uint64_t n = ring.events.size();
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t from = head > n ? head - n : 0;
+        std::vector<Event> events;
+        for (uint64_t k = from; k < head; k++)
+            events.push_back(ring.events[k & (n - 1)]);
+        // events before after - n were overwritten, and the writer may still
+        // be filling the slot of event `after`, shared with event after - n
+        uint64_t after = ring.head.load(std::memory_order_acquire);
+        uint64_t valid = after + 1 > n ? after + 1 - n : 0;
+        size_t skip = valid > from ? (size_t)std::min<uint64_t>(valid - from, events.size()) : 0;
+
+        std::string thread = ring.threadName.empty() ? cv::format("thread %d", ring.tid) : ring.threadName;
+        snprintf(buf, sizeof(buf), "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": %s}}",
+                 first ? "" : ",\n", ring.tid, metrics::jsonString(thread).c_str());
+        r += buf;
+        first = false;
+        for (size_t k = skip; k < events.size(); k++)
+        {
+            const Event& e = events[k];
+            if (e.begin < s.origin || e.end < e.begin)
+                continue;
+            int len = snprintf(buf, sizeof(buf), ",\n{\"name\": %s, \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                               metrics::jsonString(e.name).c_str(), ring.tid, (e.begin - s.origin) * usPerTick,
+                               (e.end - e.begin) * usPerTick);
+            r.append(buf, std::min<size_t>(len, sizeof(buf) - 1));
+            if (e.frame >= 0)
+                r += cv::format(", \"args\": {\"frame\": %lld}", (long long)e.frame);
+            r += "}";
+        }
+    }
+    return r + "\n]}\n";
+}
+
+#ifndef _WIN32
+// Self-pipe of the signal handler, the file is written by the watcher thread.
+inline int* signalPipe()
+{
+    static int fds[2] = {-1, -1};
+    return fds;
+}
+
+inline void onSignal(int sig)
+{
+    unsigned char c = (unsigned char)sig;
+    ssize_t ignored = write(signalPipe()[1], &c, 1);
+    (void)ignored;
+}
+#endif
+
+// Records the spans of all the threads while it lives, and writes them to
+// path when destroyed or when the process gets SIGINT or SIGTERM, which is
+// then delivered again with its default action. An empty path disables the
+// recording. One session per process.
+class Session
+{
+public:
+    explicit Session(const std::string& path_, size_t eventsPerThread = 1 << 16) : path(path_)
+    {
+        if (path.empty())
+            return;
+        State& s = State::instance();
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            size_t capacity = 1;
+            while (capacity < std::max<size_t>(eventsPerThread, 1024))
+                capacity <<= 1;
+            s.capacity = capacity;
+            s.origin = metrics::ticks();
+        }
+        metrics::secondsPerTick();
+#ifndef _WIN32
+        int* fds = signalPipe();
+        if (pipe(fds) == 0)
+        {
+            watcher = std::thread(&Session::watch, this);
+            previousInt = std::signal(SIGINT, onSignal);
+            previousTerm = std::signal(SIGTERM, onSignal);
+        }
+#endif
+        s.enabled.store(true, std::memory_order_relaxed);
+    }
+
+    // From the options of TRACE_KEYS.
+    explicit Session(const cv::CommandLineParser& parser)
+        : Session(parser.get<std::string>("trace"), (size_t)std::max(1, parser.get<int>("trace-events"))) {}
+
+    ~Session()
+    {
+        if (path.empty())
+            return;
+#ifndef _WIN32
+        if (watcher.joinable())
+        {
+            std::signal(SIGINT, previousInt);
+            std::signal(SIGTERM, previousTerm);
+            unsigned char c = 0;
+            ssize_t ignored = ::write(signalPipe()[1], &c, 1);
+            (void)ignored;
+            watcher.join();
+            close(signalPipe()[0]);
+            close(signalPipe()[1]);
+        }
+#endif
+        write();
+        State::instance().enabled.store(false, std::memory_order_relaxed);
+    }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    void write()
+    {
+        if (!metrics::writeFile(path, toJson()))
+            fprintf(stderr, "Can not write the trace to %s\n", path.c_str());
+    }
+
+private:
+#ifndef _WIN32
+    void watch()
+    {
+        unsigned char c = 0;
+        while (read(signalPipe()[0], &c, 1) < 0)
+            ;
+        if (c == 0)
+            return;
+        write();
+        fprintf(stderr, "Trace written to %s\n", path.c_str());
+        std::signal(c, SIG_DFL);
+        raise(c);
+    }
+
+    std::thread watcher;
+    void (*previousInt)(int) = SIG_DFL;
+    void (*previousTerm)(int) = SIG_DFL;
+#endif
+    std::string path;
+};
+
+// Trace file named by an environment variable, for the tools without options.
+inline std::string pathFromEnv(const char* name = "TRACE_FILE")
+{
+    const char* value = std::getenv(name);
+    return value ? value : "";
+}
+
+} // namespace trace
@@ -5,6 +5,10 @@
 #include <array>
 #include <unordered_map>
 
+#include "../machine-learning/preprocess.hpp"
+#include "../machine-learning/trace.hpp"
+#include "../machine-learning/metrics.hpp"
+
 void printImage(cv::Mat image) {
     for (int c=0; c<image.channels(); c++) {
        for (int i=0; i<image.rows; i++) {
@@ -26,57 +30,42 @@ void displayImage(cv::Mat image) {
 
 std::vector<float> process_image(const std::string& image_path, int& input_width, int& input_height, int &shortest_edge) 
 {
-    // Mean and standard deviation for normalization
-    cv::Scalar mean(0.485, 0.456, 0.406);
-    cv::Scalar std(0.229, 0.224, 0.225);
-    float rescale_factor = 1.0f / 255.0f;
-
     // Load the image using OpenCV
-    cv::Mat image = cv::imread(image_path, cv::IMREAD_COLOR);
+    cv::Mat image;
+    {
+        TRACE_SCOPE("decode");
+        image = cv::imread(image_path, cv::IMREAD_COLOR);
+    }
     if (image.empty()) {
         std::cerr << "Error opening and loading image\n";
         return {};
     }
 
-    // Convert the image to RGB (OpenCV loads in BGR by default)
-    cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-
-    // Resize the image
-    int new_width, new_height;
-    if (image.cols < image.rows) {
-        new_width = shortest_edge;
-        new_height = static_cast<int>(input_width * static_cast<float>(image.rows) / image.cols);
-    }
-    else {
-        new_height = input_height;
-        new_width = static_cast<int>(input_height * static_cast<float>(image.cols) / image.rows);
-    }
-
-    cv::resize(image, image, cv::Size(new_width, new_height), 0, 0, cv::INTER_AREA);
-
-    // Center crop the image to 518x518
-    int start_x = (new_width - input_width) / 2;
-    int start_y = (new_height - input_height) / 2;
-    cv::Rect crop_region(start_x, start_y, input_width, input_height);
-    image = image(crop_region);
-
-    // Convert the image to float and rescale
-    image.convertTo(image, CV_32F, rescale_factor);
-
-    // Normalize the image
-    cv::subtract(image, mean, image);
-    cv::divide(image, std, image);
-
-    // Convert image to a flattened vector in NCHW format (channel-first)
-    std::vector<float> input_tensor_values;
-    input_tensor_values.assign((float*)image.datastart, (float*)image.dataend);
-
-    // Return the preprocessed image vector
+    // Resize the shortest edge, center crop, convert to RGB, rescale and
+    // normalise in one pass, straight into the NCHW tensor
+    PreprocessSpec spec;
+    spec.size = cv::Size(input_width, input_height);
+    spec.resize = RESIZE_CROP;
+    spec.shortestEdge = shortest_edge;
+    spec.interpolation = cv::INTER_AREA;
+    spec.mean = cv::Scalar(0.485, 0.456, 0.406) * 255;
+    spec.std = cv::Scalar(0.229, 0.224, 0.225);
+    spec.scale = 1.0 / 255.0;
+    spec.swapRB = true;
+    PreprocessKernel kernel(spec);
+
+    std::vector<float> input_tensor_values(kernel.elements(image.size()));
+    kernel.run(image, input_tensor_values.data());
     return input_tensor_values;
 }
 
 int main() 
 {
+    // traced when the TRACE_FILE environment variable names the output file
+    trace::Session tracing(trace::pathFromEnv());
+    // metrics written when METRICS_JSON or METRICS_PROM name the output files
+    metrics::Reporter reporter(metrics::pathFromEnv("METRICS_JSON"), metrics::pathFromEnv("METRICS_PROM"));
+
     // Constant
     const std::string model_path = "/home/pc/dev/opencv/models/temp/dinov2.onnx";
     const std::string image_path = "/home/pc/dev/dataset/samples/truck.jpg";
@@ -88,7 +77,9 @@ int main()
     Ort::Env env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ort-openvino");
     Ort::SessionOptions session_options;
     session_options.SetIntraOpNumThreads(8);
+    trace::Span createSpan("session.create");
     Ort::Session session(env, model_path.c_str(), session_options);
+    createSpan.end();
 
     // Define batch size and input/output sizes
     int64_t batch_size = 1;
@@ -121,7 +112,11 @@ int main()
     const char* output_names[] = {"output"};
 
     // Run the model
-    session.Run(Ort::RunOptions{nullptr}, input_names, &input_tensor, 1, output_names, &output_tensor, 1);
+    {
+        TRACE_SCOPE("session.Run");
+        metrics::ScopedTimer timer(metrics::histogram("ort_openvino.session_run"));
+        session.Run(Ort::RunOptions{nullptr}, input_names, &input_tensor, 1, output_names, &output_tensor, 1);
+    }
 
     // Print a success message
     std::cout << "Model inference completed successfully.\n";